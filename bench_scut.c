@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2016 Fredrik Skogman, skogman - at - gmail.com.
+ * This file is part of Scut.
+ *
+ * The contents of this file are subject to the terms of the Common
+ * Development and Distribution License (the "License"). You may not use this file
+ * except in compliance with the License. You can obtain a copy of the License at
+ * http://opensource.org/licenses/CDDL-1.0. See the License for the specific
+ * language governing permissions and limitations under the License. When
+ * distributing the software, include this License Header Notice in each file and
+ * include the License file at http://opensource.org/licenses/CDDL-1.0.
+ */
+
+/*
+ * Measures what scut itself costs per test, by running suites of
+ * trivial tests. One JSON object per line and scenario is written to
+ * stdout, the reports of the suites go to /dev/null:
+ *
+ * {"bench":"empty_1k","tests":1000,"jobs":1,"runs":25,
+ *  "ns_per_test":812.4,"min_ns_per_test":790.1,"ns_total":812400}
+ *
+ * Arguments select scenarios by name, e.g. bench_scut empty_1k signal.
+ */
+
+#include "scut.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+/* Each scenario is run until this much time has passed, at least once */
+#define BENCH_NS 500000000LL
+#define MAX_RUNS 25
+
+struct scenario
+{
+        const char* name;
+        int (*test)(void);
+        int tests;
+        int jobs;
+        int flags;
+};
+
+static int bench_empty(void);
+static int bench_output(void);
+static int bench_signal(void);
+static int bench_fail(void);
+static int bench_expect(void);
+static long long now(void);
+static int compare(const void*, const void*);
+static void run(const struct scenario*);
+
+static const struct scenario scenarios[] = {
+        {"empty_1k", bench_empty, 1000, 1, 0},
+        {"empty_100k", bench_empty, 100000, 1, 0},
+        {"empty_1m", bench_empty, 1000000, 1, 0},
+        {"output", bench_output, 1000, 1, 0},
+        {"signal", bench_signal, 1000, 1, 0},
+        {"fail", bench_fail, 1000, 1, 0},
+        {"expect", bench_expect, 1000, 1, 0},
+        {"empty_jsonl", bench_empty, 1000, 1, SCUT_JSONL},
+        {"empty_parallel", bench_empty, 10000, 2, 0},
+        {NULL, NULL, 0, 0, 0}
+};
+
+int main(int argc, char** argv)
+{
+        for (const struct scenario* s = scenarios; s->name; ++s)
+        {
+                int selected = argc < 2;
+
+                for (int i = 1; i < argc; ++i)
+                {
+                        selected |= strcmp(argv[i], s->name) == 0;
+                }
+                if (selected)
+                {
+                        run(s);
+                }
+        }
+
+        return 0;
+}
+
+static int bench_empty(void)
+{
+        return 0;
+}
+
+/* About 4 kB of output, captured and thrown away as the test passes */
+static int bench_output(void)
+{
+        for (int i = 0; i < 64; ++i)
+        {
+                printf("%2d: the quick brown fox jumps over the lazy dog...\n", i);
+        }
+
+        return 0;
+}
+
+static int bench_signal(void)
+{
+        SCUT_EXPECT_SIG(SIGUSR1);
+        raise(SIGUSR1);
+        SCUT_ASSERT_SIG(SIGUSR1);
+
+        return 0;
+}
+
+/* A failed assertion, so the captured output is reported */
+static int bench_fail(void)
+{
+        SCUT_ASSERT_IE(1, 2);
+
+        return 0;
+}
+
+static int bench_expect(void)
+{
+        for (int i = 0; i < 100; ++i)
+        {
+                SCUT_EXPECT_IE(i, i);
+        }
+        SCUT_EXPECT_IE(1, 2);
+
+        return 0;
+}
+
+static long long now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compare(const void* a, const void* b)
+{
+        long long x = *(const long long*)a;
+        long long y = *(const long long*)b;
+
+        return (x > y) - (x < y);
+}
+
+/*
+ * Run the suite of a scenario repeatedly, and report the median and the
+ * fastest run. Adding the tests is not measured.
+ */
+static void run(const struct scenario* s)
+{
+        long long took[MAX_RUNS];
+        long long start = now();
+        char jobs[16];
+        int runs = 0;
+        int out = dup(1);
+        int null = open("/dev/null", O_WRONLY);
+
+        if (out < 0 || null < 0)
+        {
+                perror("bench_scut");
+                exit(1);
+        }
+        scut_create(s->name);
+        for (int i = 0; i < s->tests; ++i)
+        {
+                scut_add(s->test, s->name);
+        }
+        snprintf(jobs, sizeof(jobs), "%d", s->jobs);
+        setenv("SCUT_JOBS", jobs, 1);
+
+        while (runs < MAX_RUNS && (runs == 0 || now() - start < BENCH_NS))
+        {
+                long long t;
+
+                fflush(stdout);
+                dup2(null, 1);
+                t = now();
+                scut_run(s->flags);
+                took[runs++] = now() - t;
+                fflush(stdout);
+                dup2(out, 1);
+        }
+        unsetenv("SCUT_JOBS");
+        scut_destroy();
+        close(null);
+        close(out);
+
+        qsort(took, runs, sizeof(took[0]), compare);
+        printf("{\"bench\":\"%s\",\"tests\":%d,\"jobs\":%d,\"runs\":%d,"
+               "\"ns_per_test\":%.1f,\"min_ns_per_test\":%.1f,"
+               "\"ns_total\":%lld}\n",
+               s->name,
+               s->tests,
+               s->jobs,
+               runs,
+               (double)took[runs / 2] / s->tests,
+               (double)took[0] / s->tests,
+               took[runs / 2]);
+        fflush(stdout);
+}
@@ -45,7 +45,11 @@ int main(int argc, char** argv)
         SCUT_ADD(test_float);
         SCUT_ADD(test_sig_die);
         SCUT_ADD(test_sig_catch);
-        
+        /* All tests defined with SCUT_TEST */
+        SCUT_ADD_ALL();
+        /* --filter=PATTERNS and --shard=INDEX/TOTAL */
+        scut_args(argc, argv);
+
         if (verbose)
         {
                 scut_run(SCUT_VERBOSE);
@@ -77,7 +81,8 @@ int test_float(void)
         float a = 0.01f;
         float b = 0.02f;
 
-        SCUT_ASSERT_TRUE((b - a) < 1.0f);
+        SCUT_ASSERT_NEAR(b - a, 0.01f, 1e-6);
+        SCUT_ASSERT_ULP(a + a, b, 1);
 
         return 0;
 }
@@ -103,6 +108,13 @@ int test_sig_catch(void)
         return 0;
 }
 
+SCUT_TEST(test_auto)
+{
+        SCUT_ASSERT_IE(3, incr(2));
+
+        return 0;
+}
+
 int incr(int i)
 {
         return i + 1;
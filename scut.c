@@ -17,19 +17,372 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <setjmp.h>
+#include <errno.h>
+#include <limits.h>
+#include <fnmatch.h>
+#include <glob.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <pthread.h>
+#include <math.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 #define MAX_MSG 256
-#define MAX_SIG 1024
 #define BOLD "\x1b[1m"
 #define BOLDOFF "\x1b[21m"
+/* Captured output beyond head + tail bytes is cut out of the middle */
+#define CAPTURE_HEAD (32 * 1024)
+#define CAPTURE_TAIL (32 * 1024)
+/* Benchmarks are measured in this many batches, at least */
+#define BENCH_BATCHES 100
+#define BENCH_MAX_BATCHES 10000
+/* Default time spent measuring a benchmark, in milliseconds */
+#define BENCH_TIME 250
+/* Log-bucketed histogram, 8 linear sub-buckets per power of two */
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_SIZE ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+/* Report output is written in chunks of this size */
+#define OUT_BUF (64 * 1024)
+/* Number of slowest tests listed in the summary with SCUT_STATS */
+#define SLOWEST 5
+/* Differing buffers are scanned in chunks, equal ones skipped by memcmp */
+#define MEM_CHUNK 4096
+/* Rows of 16 bytes dumped around the first difference of two buffers */
+#define MEM_ROWS 3
+/* Buckets of the error summary of differing floating point arrays */
+#define FLOAT_BUCKETS 6
+/* Precision of a reported error, ULPs are whole numbers */
+#define FLOAT_ERROR_DIGITS(kind) ((kind) == SCUT_TOL_ULP ? 20 : 6)
+/* Failed expectations kept per test, the rest are only counted */
+#define MAX_FAILURES 32
+/* Threads of scut_stress keep their results this far apart */
+#define CACHE_LINE 64
+/* Kinds of failed expectations */
+#define FAIL_IE 0
+#define FAIL_BOOL 1
+#define FAIL_NEAR 2
+/* longjmp value used by the watchdog, outside the range of signals */
+#define JMP_TIMEOUT 0x10000
+/* Thread local storage */
+#if defined(__GNUC__) || defined(__SUNPRO_C)
+#define SCUT_TLS __thread
+#else
+#define SCUT_TLS _Thread_local
+#endif
+/* Confidence needed to fail a test that is slower than its baseline */
+#define REGRESSION_CONFIDENCE 0.95
+/* Weight of the last run in the duration history, as 1/HISTORY_WEIGHT */
+#define HISTORY_WEIGHT 2
+/* The running executable, whose identity keys the result cache */
+#if defined(__FreeBSD__)
+#define SELF_EXE "/proc/curproc/file"
+#elif defined(__sun)
+#define SELF_EXE "/proc/self/path/a.out"
+#else
+#define SELF_EXE "/proc/self/exe"
+#endif
+/* 
+ * Heap allocations are counted by interposing malloc and friends, which
+ * needs the glibc entry points to forward to. That replaces the allocator
+ * of every program linking scut, so it is only built with
+ * SCUT_ALLOC_HOOKS. Sanitizers bring their own allocator, leave it alone.
+ */
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && \
+        defined(SCUT_ALLOC_HOOKS)
+#define ALLOC_HOOKS
+#endif
+/* Performance counters, see SCUT_PERF_* */
+#define PERF_EVENTS 8
+/* ELF note type of the GNU build-id */
+#define NT_BUILD_ID 3
+/* History file used for --failed-first if none is given */
+#define HISTORY ".scut_history"
+/* Extra time a worker gets to time out on its own before it is killed */
+#define KILL_GRACE_MS 500
+/* Cases tried by a property if neither a count nor a time is given */
+#define PROP_CASES 1000
+/* Searches of at least this many cases are spread over the CPUs */
+#define PROP_FORK_CASES 10000
+/* Choices recorded per case, later ones are replayed as 0 */
+#define PROP_TAPE (1 << 20)
+/* Replays spent shrinking a counterexample, at most */
+#define PROP_SHRINKS 10000
+/* Distance between the seeds of consecutive cases */
+#define PROP_GAMMA 0x9e3779b97f4a7c15ULL
 
 struct scut_test
 {
         int (*test)(void);
+        int (*bench)(struct scut_bench*);
+        /* A parameterized test is called once per case in its table */
+        int (*param)(const void*);
+        const void* table;
+        size_t size;
+        int cases;
+        /* A property is called with generated input until it fails */
+        int (*prop)(struct scut_prop*);
+        int prop_cases;
+        int prop_ms;
+        /* Suite fixtures the test declared with scut_suite_use */
+        const struct scut_fixture** fixtures;
+        int num_fixtures;
         const char* name;
+        int timeout;
+        /* Allowed slowdown against the baseline, < 0 if not checked */
+        double tolerance;
+        /* Set by test_at: unit number in the suite, and index of the case */
+        int unit;
+        int index;
+};
+
+struct scut_bench_result
+{
+        int ran;
+        unsigned long long bytes;
+        double ns_op;
+        double p50;
+        double p90;
+        double p99;
+        double max;
+        /* Variance of the time per iteration over the batches */
+        double var;
+        unsigned long long batches;
+};
+
+/* Count, mean and variance of timing samples, in nanoseconds */
+struct scut_sample
+{
+        long long n;
+        double mean;
+        double var;
+};
+
+/*
+ * Property tests draw all random values from a tape of choices. While
+ * searching, the tape is filled from the PRNG. To shrink, edited tapes
+ * are replayed, and reading past the end gives 0. Generators map smaller
+ * choices to simpler values, so a shorter tape with smaller choices
+ * that still fails is a simpler counterexample.
+ */
+struct scut_prop
+{
+        int (*prop)(struct scut_prop*);
+        /* xoshiro256** state */
+        unsigned long long s[4];
+        unsigned long long* tape;
+        unsigned long long* spare;
+        int len;
+        int cap;
+        int pos;
+        int replay;
+        /* Signal which ended the last case, 0 if it returned */
+        int sig;
+};
+
+/* A suite fixture built during a run */
+struct scut_built
+{
+        const struct scut_fixture* fixture;
+        void* data;
+        int failed;
+};
+
+struct scut_usage
+{
+        long long utime;
+        long long stime;
+        long maxrss;
+        long minflt;
+        long majflt;
+        long nvcsw;
+        long nivcsw;
+        long long rbytes;
+        long long wbytes;
+        /* Bytes read by the sampling itself */
+        long long own;
+};
+
+/* Heap allocations of a test, bytes as usable size of the blocks */
+struct scut_allocs
+{
+        long long allocs;
+        long long frees;
+        long long bytes;
+        long long live;
+        long long peak;
+};
+
+/* Counts of the performance counters, -1 if unavailable */
+struct scut_perf
+{
+        long long v[PERF_EVENTS];
+};
+
+/*
+ * A failed expectation, kept as values and formatted when it is
+ * reported. The strings are literals of the test program, so they are
+ * valid in the parent of a forked worker too.
+ */
+struct scut_failure
+{
+        int kind;
+        int line;
+        const char* file;
+        const char* expr;
+        long long found;
+        long long expected;
+        /* Values of SCUT_EXPECT_NEAR, _REL and _ULP */
+        double x;
+        double y;
+        double tol;
+        int tol_kind;
+        int single;
+};
+
+/* The last stress run of a test, see scut_stress */
+struct scut_stress
+{
+        int threads;
+        int failed;
+        long long iterations;
+        long long ns;
+};
+
+/* Shared by the threads of a stress run, only read once they started */
+struct scut_stress_run
+{
+        int (*fn)(int, long long);
+        long long iterations;
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        int ready;
+        int go;
+        int finished;
+        /* Set when the test timed out, the threads stop at the next call */
+        volatile int stop;
+};
+
+/* A thread of a stress run, which alone writes its results */
+struct scut_stress_thread
+{
+        struct scut_stress_run* run;
+        pthread_t tid;
+        int thread;
+        int failed;
+        long long done;
+        /* Signal that ended the thread, and where it jumps to */
+        int sig;
+        sigjmp_buf env;
+        char pad[CACHE_LINE];
+};
+
+struct scut_slow
+{
+        long long ns;
+        char name[MAX_MSG];
+};
+
+/* Expected duration and last outcome of a test, from the history file */
+struct scut_timing
+{
+        char* name;
+        long long ns;
+        int failed;
+        /* Identity of the executable that produced the outcome */
+        char* id;
+        /* Samples of the test in a baseline */
+        struct scut_sample sample;
+};
+
+/* Open addressed hash table of timings, keyed by test name */
+struct scut_timings
+{
+        struct scut_timing* e;
+        size_t cap;
+        size_t len;
+};
+
+/* A selected test and its expected duration, for sorting */
+struct scut_est
+{
+        long long ns;
+        int pos;
+        int failed;
+};
+
+struct scut_buf
+{
+        char* data;
+        size_t len;
+        size_t cap;
+};
+
+struct scut_result
+{
+        int ret;
+        int sig;
+        int status;
+        int timed_out;
+        /* Passed with the same executable before, not run */
+        int cached;
+        long long ns;
+        struct scut_bench_result bench;
+        int has_usage;
+        struct scut_usage usage;
+        int has_allocs;
+        struct scut_allocs allocs;
+        int has_perf;
+        struct scut_perf perf;
+        /* Timing of a passed test, and how it compares to its baseline */
+        struct scut_sample sample;
+        int has_baseline;
+        struct scut_sample base;
+        double tolerance;
+        double confidence;
+        int regressed;
+        int has_stress;
+        struct scut_stress stress;
+        /* Failed expectations, of which the first recorded are in fail */
+        int failures;
+        int recorded;
+        struct scut_failure* fail;
+        size_t len;
+};
+
+struct scut_worker
+{
+        pid_t pid;
+        int cmd;
+        int res;
+        int test;
+        int killed;
+        long long start;
+        /* Tests run by this process, for scut_suite_isolate */
+        int ran;
+};
+
+struct scut_reporter
+{
+        void (*suite_start)(void);
+        void (*test_start)(struct scut_test*);
+        void (*test_end)(struct scut_test*, struct scut_result*, const char*);
+        void (*suite_end)(int, int);
+        /* A test skipped by fail fast, NULL if the reporter only counts */
+        void (*test_skip)(struct scut_test*);
 };
 
 struct scut_suite
@@ -38,290 +391,6551 @@ struct scut_suite
         struct scut_test* tests;
         int cap;
         int count;
-        int* sig_catched;
-        int* sig_expected;
-        int catch_sig_pos;
-        int exp_sig_pos;
+        /* Number of tests, counting each case of a parameterized test */
+        int units;
+        int timeout;
+        /* Name patterns and shard, see scut_suite_filter/scut_suite_shard */
+        char* filter;
+        char* history;
+        int shard_index;
+        int shard_total;
+        int failed_first;
+        int fail_fast;
+        int cache;
+        char* baseline;
+        int baseline_save;
+        int isolate;
+        /* Called around every test, see scut_suite_setup */
+        int (*setup)(void);
+        int (*teardown)(void);
+};
+
+/* State of one scut_suite_run, owned by the thread running it */
+struct scut_run
+{
+        struct scut_suite* suite;
+        struct scut_run* prev;
+        int flags;
+        /* Units of the selected tests, in the order they are reported */
+        int* order;
+        int count;
+        /* First unit of each test, NULL if all tests are one unit */
+        int* first;
+        /* The test returned by test_at, and the name of a case */
+        struct scut_test at;
+        char at_name[MAX_MSG];
+        /* Positions in order, in the order they are handed to workers */
+        int* dispatch;
+        /* Duration history, and results of this run by test index */
+        const char* history;
+        struct scut_timings timings;
+        struct scut_timing* took;
+        int failed_first;
+        /* Shard of this run, -1 if not sharded, and shard files merged in */
+        int shard;
+        glob_t merged;
+        /* Tests per forked process, 0 to run them in this one */
+        int isolate;
+        /* Baseline timings, and the samples of this run by unit */
+        const char* baseline;
+        int baseline_save;
+        double tolerance;
+        struct scut_timings base;
+        struct scut_sample* samples;
+        /* Counters of the process running the tests, opened on first use */
+        int perf_fd[PERF_EVENTS];
+        pid_t perf_pid;
+        struct scut_perf perf_start;
+        /* Suite fixtures, in the order they were built */
+        struct scut_built* built;
+        int num_built;
+        /* Set while the per test teardown is due */
+        int set_up;
+        /* Stop after this many failures, the rest are skipped */
+        int fail_fast;
+        int skipped;
+        /* Executable identity if the result cache is on, by position */
+        const char* id;
+        char* cached;
+        int num_cached;
+        /* Capture file, -1 if stdout is not captured */
+        int fd;
+        /* Set in a forked worker, which owns its stdout */
+        int worker;
+        volatile sig_atomic_t in_test;
+        const struct scut_reporter* reporter;
+        char obuf[OUT_BUF];
+        size_t olen;
+        pid_t opid;
+        struct scut_buf* sink;
+        struct scut_buf body;
+        int test_num;
+        struct scut_slow* slowest;
+        int slowest_cap;
+        int slowest_len;
+        volatile long long deadline;
+        /* Signals the current test expects, and those it has received */
+        sigset_t sig_expected;
+        sigset_t sig_caught;
+        /* Failed expectations of the current test, from any thread */
+        struct scut_failure failures[MAX_FAILURES];
+        volatile int num_failures;
+        int has_stress;
+        struct scut_stress stress;
+        /* Processes of a property search, stopped if the test is cut short */
+        pid_t* prop_pids;
+        int prop_jobs;
+        int prop_fd;
+        /* SCUT_TIMEOUT, read once per run */
+        int env_timeout;
+        int env_jobs;
         jmp_buf env;
+        /* Signal mask of tests, of the thread between tests, and before */
         sigset_t sigmask;
+        sigset_t idle_mask;
+        sigset_t old_mask;
 };
 
-static int out;
+/*
+ * Stdout (fd 1) and the signal handlers belong to the whole process. 
+ * Runs in different threads each have their own capture file, but only
+ * one test at a time may have it installed as fd 1. That test runs in
+ * test_thread, and signals delivered to any other thread are passed on
+ * to it. Report output from all runs goes to the real stdout, which is
+ * kept in real_out while some run is capturing.
+ */
+static SCUT_TLS struct scut_run* cur;
+/* Allocation tracking of the calling thread, nested by the assertions */
+static SCUT_TLS int alloc_depth;
+static SCUT_TLS long long alloc_total;
+static SCUT_TLS struct scut_allocs alloc_stats;
+/* Threads tracking allocations, so the hooks cost one load when off */
+static volatile int alloc_threads;
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+static int captures;
+static int real_out = -1;
+static int installed = -1;
+static pthread_t test_thread;
+static volatile sig_atomic_t test_running;
+/* The run of the test that is running, for threads the test started */
+static struct scut_run* volatile test_run;
+/* Set in the threads of scut_stress, which recover from their faults */
+static SCUT_TLS struct scut_stress_thread* stress_self;
+#if !defined(__GNUC__)
+static pthread_mutex_t fail_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+static volatile sig_atomic_t parallel_runs;
 static struct scut_suite* suite;
+static struct scut_auto* auto_head;
+static struct scut_auto* auto_tail;
+static int auto_count;
 
 static void prepare_test(void);
 static char* drain(int fd);
 static void say(const char*);
+static void say_n(const char*, size_t);
+static void say_json(const char*);
+static void say_xml(const char*);
+static void say_lines(const char*, const char*);
+static void write_out(const char*, size_t);
+static void flush(int);
+static void flush_at_exit_setup(void);
+static void flush_at_exit(void);
+static int capture_file(void);
+static int capture_start(void);
+static void capture_stop(int);
+static void enter_test(void);
+static void leave_test(void);
+static void idle_signals(sigset_t*);
+static void unblock_idle(sigset_t*);
+static int pread_all(int, char*, size_t, off_t);
+static void run_test(struct scut_test*, int, struct scut_result*, char**);
+static int run_serial(int);
+static int run_parallel(int);
+static void report_start(struct scut_test*);
+static void report_end(struct scut_test*, struct scut_result*, const char*);
+static void report_skip(struct scut_test*);
+static const struct scut_reporter* get_reporter(int);
+static const char* result_name(struct scut_result*);
+static int result_msg(struct scut_result*, char*, size_t);
+static void human_suite_start(void);
+static void human_test_start(struct scut_test*);
+static void human_test_end(struct scut_test*, struct scut_result*, const char*);
+static void human_suite_end(int, int);
+static void human_usage(const struct scut_usage*);
+static void human_allocs(const struct scut_allocs*);
+static void human_baseline(const struct scut_result*);
+static void human_failures(const struct scut_result*);
+static void human_stress(const struct scut_stress*);
+static void human_perf(const struct scut_perf*);
+static void human_slowest(void);
+static void tap_suite_start(void);
+static void tap_test_start(struct scut_test*);
+static void tap_test_end(struct scut_test*, struct scut_result*, const char*);
+static void tap_suite_end(int, int);
+static void junit_suite_start(void);
+static void junit_test_end(struct scut_test*, struct scut_result*, const char*);
+static void junit_suite_end(int, int);
+static void junit_test_skip(struct scut_test*);
+static void jsonl_suite_start(void);
+static void jsonl_test_start(struct scut_test*);
+static void jsonl_test_end(struct scut_test*, struct scut_result*, const char*);
+static void jsonl_failures(const struct scut_result*);
+static void jsonl_suite_end(int, int);
+static void usage_get(struct scut_usage*);
+static void alloc_track(int);
+static int alloc_pause(void);
+static void alloc_resume(int);
+static void usage_diff(struct scut_usage*, const struct scut_usage*);
+static void alloc_leaked(const struct scut_allocs*, long long*, long long*);
+static void perf_open(void);
+static void perf_close(void);
+static void perf_read(struct scut_perf*);
+static long long perf_value(int);
+static int run_body(struct scut_test*, struct scut_result*);
+static int get_jobs(int);
+static int get_timeout(struct scut_test*);
+static void watchdog(int);
+static long long now_ns(void);
+static int spawn_worker(struct scut_worker*, int, int);
+static int stop_worker(struct scut_worker*);
+static void worker_main(int, int);
+static int read_all(int, void*, size_t);
+static int write_all(int, const void*, size_t);
+static int reserve(struct scut_suite*, int);
+static int set_string(char**, const char*);
+static struct scut_test* test_at(int);
+static struct scut_test* test_unit(int);
+static int select_tests(void);
+static int filter_match(const char*, const char*);
+static int get_shard(int*, int*);
+static int shard_lpt(struct scut_est*, int, int, int);
+static int est_cmp(const void*, const void*);
+static int failed_first(struct scut_est*, int);
+static int env_int(const char*);
+static int env_count(const char*, int*);
+static int parse_count(const char*, int, int*);
+static int timing_load(struct scut_timings*, const char*);
+static int history_merge(void);
+static int history_save(void);
+static int timing_save(struct scut_timings*, const char*);
+static struct scut_timing* timing_find(struct scut_timings*, const char*);
+static int timing_put(struct scut_timings*, 
+                      const char*, 
+                      long long, 
+                      int, 
+                      const char*);
+static int next_test(int*);
+static const char* binary_id(void);
+static void binary_id_init(void);
+static int build_id(int, char*, size_t);
+static int pread_num(int, off_t, int, unsigned long long*);
+static void timing_free(struct scut_timings*);
+static int baseline_load(struct scut_timings*, const char*);
+static int baseline_save(struct scut_timings*, const char*);
+static int baseline_update(void);
+static void baseline_check(struct scut_test*, struct scut_result*);
+static void sample_merge(struct scut_sample*, const struct scut_sample*);
+static double regression_confidence(const struct scut_sample*, 
+                                    const struct scut_sample*, 
+                                    double);
+static double student_cdf(double, double);
+static double beta_inc(double, double, double);
+static unsigned long long hash_name(const char*);
+static int add(struct scut_suite*, 
+               int (*)(void), 
+               int (*)(struct scut_bench*), 
+               const char*, 
+               int);
+static int run_bench(struct scut_test*, struct scut_bench_result*);
+static int run_prop(struct scut_test*);
+static int test_setup(struct scut_test*);
+static int fixture_get(const struct scut_fixture*, void**);
+static void fixtures_teardown(void);
+static int prop_case(struct scut_prop*);
+static long long prop_search(struct scut_prop*, 
+                             unsigned long long, 
+                             long long, 
+                             int, 
+                             long long, 
+                             long long, 
+                             long long*);
+static void prop_stop(void);
+static long long prop_fork(struct scut_prop*, 
+                           unsigned long long, 
+                           int, 
+                           long long, 
+                           long long, 
+                           long long*);
+static int prop_shrink(struct scut_prop*);
+static int prop_try(struct scut_prop*, int, int*);
+static void prop_seed(struct scut_prop*, unsigned long long);
+static unsigned long long prop_draw(struct scut_prop*);
+static unsigned long long splitmix(unsigned long long*);
+static int bench_time(void);
+static int hist_bucket(unsigned long long);
+static double hist_value(int);
+static double hist_percentile(const unsigned long long*, unsigned long long, double);
+static size_t mem_first(const unsigned char*, const unsigned char*, size_t);
+static size_t mem_count(const unsigned char*, const unsigned char*, size_t);
+static void mem_dump(const unsigned char*, 
+                     const unsigned char*, 
+                     size_t, 
+                     size_t);
+static int float_over(const void*, const void*, size_t, size_t, int, double);
+static double float_at(const void*, size_t, size_t);
+static double float_error(double, double, int, int);
+static unsigned long long float_key(double, int);
+static void float_tol(char*, size_t, int, double);
+static void fail_add(const struct scut_failure*);
+static void* stress_thread(void*);
+static int stress_stopped(struct scut_stress_run*);
+static void stress_done(struct scut_stress_run*);
+static int fail_msg(const struct scut_failure*, char*, size_t);
 static int sig_setup(void);
 static void sig_trap(int);
 
-void scut_create(const char* name)
+scut_suite_t* scut_suite_new(const char* name)
+{
+        struct scut_suite* s = malloc(sizeof(struct scut_suite));
+
+        if (s)
+        {
+                s->cap = 64;
+                s->count = 0;
+                s->units = 0;
+                s->timeout = 0;
+                s->filter = NULL;
+                s->history = NULL;
+                s->shard_index = 0;
+                s->shard_total = 0;
+                s->failed_first = 0;
+                s->fail_fast = 0;
+                s->cache = 0;
+                s->baseline = NULL;
+                s->baseline_save = 0;
+                s->isolate = 0;
+                s->setup = NULL;
+                s->teardown = NULL;
+                s->name = name;
+                s->tests = malloc(sizeof(struct scut_test) * s->cap);
+                if (!s->tests)
+                {
+                        free(s);
+                        s = NULL;
+                }
+        }
+
+        return s;
+}
+
+void scut_suite_free(scut_suite_t* s)
+{
+        if (s)
+        {
+                for (int i = 0; i < s->count; ++i)
+                {
+                        free(s->tests[i].fixtures);
+                }
+                free(s->tests);
+                free(s->filter);
+                free(s->history);
+                free(s->baseline);
+                free(s);
+        }
+}
+
+int scut_suite_add(scut_suite_t* s, int (*test)(void), const char* name)
+{
+        return scut_suite_add_timeout(s, test, name, 0);
+}
+
+int scut_suite_add_timeout(scut_suite_t* s, 
+                           int (*test)(void), 
+                           const char* name, 
+                           int ms)
+{
+        if (test == NULL)
+        {
+                return 1;
+        }
+
+        return add(s, test, NULL, name, ms);
+}
+
+int scut_suite_add_bench(scut_suite_t* s, 
+                         int (*bench)(struct scut_bench*), 
+                         const char* name)
+{
+        if (bench == NULL)
+        {
+                return 1;
+        }
+
+        return add(s, NULL, bench, name, 0);
+}
+
+int scut_suite_add_param(scut_suite_t* s, 
+                         int (*test)(const void*), 
+                         const char* name,
+                         const void* table,
+                         size_t size,
+                         int n)
+{
+        if (test == NULL || table == NULL || n <= 0)
+        {
+                return 1;
+        }
+        if (add(s, NULL, NULL, name, 0))
+        {
+                return 1;
+        }
+
+        /* The table is not copied, cases are looked up as they run */
+        s->tests[s->count - 1].param = test;
+        s->tests[s->count - 1].table = table;
+        s->tests[s->count - 1].size = size;
+        s->tests[s->count - 1].cases = n;
+        s->units += n - 1;
+
+        return 0;
+}
+
+int scut_suite_add_prop(scut_suite_t* s, 
+                        int (*prop)(struct scut_prop*), 
+                        const char* name,
+                        int cases,
+                        int ms)
+{
+        if (prop == NULL || add(s, NULL, NULL, name, 0))
+        {
+                return 1;
+        }
+
+        s->tests[s->count - 1].prop = prop;
+        s->tests[s->count - 1].prop_cases = cases;
+        s->tests[s->count - 1].prop_ms = ms;
+
+        return 0;
+}
+
+int scut_suite_add_all(scut_suite_t* s)
+{
+        if (reserve(s, s->count + auto_count))
+        {
+                return 1;
+        }
+
+        for (struct scut_auto* a = auto_head; a; a = a->next)
+        {
+                if (add(s, a->test, a->bench, a->name, 0))
+                {
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+void scut_suite_timeout(scut_suite_t* s, int ms)
+{
+        s->timeout = ms;
+}
+
+void scut_suite_setup(scut_suite_t* s, 
+                      int (*setup)(void), 
+                      int (*teardown)(void))
+{
+        s->setup = setup;
+        s->teardown = teardown;
+}
+
+int scut_suite_use(scut_suite_t* s, const struct scut_fixture* fixture)
+{
+        struct scut_test* t;
+        const struct scut_fixture** fixtures;
+
+        if (s->count == 0 || fixture == NULL)
+        {
+                return 1;
+        }
+        t = s->tests + s->count - 1;
+        fixtures = realloc(t->fixtures, 
+                           sizeof(*fixtures) * (t->num_fixtures + 1));
+        if (fixtures == NULL)
+        {
+                return 1;
+        }
+        fixtures[t->num_fixtures++] = fixture;
+        t->fixtures = fixtures;
+
+        return 0;
+}
+
+int scut_suite_no_regression(scut_suite_t* s, double tolerance)
+{
+        if (s->count == 0 || tolerance < 0)
+        {
+                return 1;
+        }
+        s->tests[s->count - 1].tolerance = tolerance;
+
+        return 0;
+}
+
+static int set_string(char** dst, const char* src)
+{
+        char* copy = NULL;
+
+        if (src)
+        {
+                copy = malloc(strlen(src) + 1);
+                if (copy == NULL)
+                {
+                        return 1;
+                }
+                strcpy(copy, src);
+        }
+        free(*dst);
+        *dst = copy;
+
+        return 0;
+}
+
+int scut_suite_filter(scut_suite_t* s, const char* filter)
+{
+        return set_string(&s->filter, filter);
+}
+
+int scut_suite_history(scut_suite_t* s, const char* path)
+{
+        return set_string(&s->history, path);
+}
+
+int scut_suite_shard(scut_suite_t* s, int index, int total)
+{
+        if (total < 0 || index < 0 || (total > 0 && index >= total))
+        {
+                return 1;
+        }
+        s->shard_index = index;
+        s->shard_total = total;
+
+        return 0;
+}
+
+void scut_suite_failed_first(scut_suite_t* s, int on)
+{
+        s->failed_first = on;
+}
+
+void scut_suite_fail_fast(scut_suite_t* s, int n)
+{
+        s->fail_fast = n;
+}
+
+void scut_suite_cache(scut_suite_t* s, int on)
+{
+        s->cache = on;
+}
+
+void scut_suite_isolate(scut_suite_t* s, int n)
+{
+        s->isolate = n;
+}
+
+int scut_suite_baseline(scut_suite_t* s, const char* path, int save)
+{
+        s->baseline_save = save;
+
+        return set_string(&s->baseline, path);
+}
+
+int scut_suite_args(scut_suite_t* s, int argc, char** argv)
+{
+        for (int i = 1; i < argc; ++i)
+        {
+                const char* a = argv[i];
+                const char* v = NULL;
+
+                if (strncmp(a, "--filter=", 9) == 0)
+                {
+                        v = a + 9;
+                }
+                else if (strcmp(a, "--filter") == 0 && i + 1 < argc)
+                {
+                        v = argv[++i];
+                }
+                if (v && scut_suite_filter(s, v))
+                {
+                        return 1;
+                }
+                if (strncmp(a, "--history=", 10) == 0 && 
+                    scut_suite_history(s, a + 10))
+                {
+                        return 1;
+                }
+                if (strncmp(a, "--baseline=", 11) == 0 && 
+                    set_string(&s->baseline, a + 11))
+                {
+                        return 1;
+                }
+                if (strcmp(a, "--save-baseline") == 0)
+                {
+                        s->baseline_save = 1;
+                }
+                if (strcmp(a, "--isolate") == 0)
+                {
+                        scut_suite_isolate(s, 1);
+                }
+                if (strncmp(a, "--isolate=", 10) == 0)
+                {
+                        int n;
+
+                        if (parse_count(a + 10, 1, &n))
+                        {
+                                fprintf(stderr, "Invalid isolate %s\n", a + 10);
+                                return 1;
+                        }
+                        scut_suite_isolate(s, n);
+                }
+                if (strcmp(a, "--failed-first") == 0)
+                {
+                        scut_suite_failed_first(s, 1);
+                }
+                if (strcmp(a, "--cache") == 0)
+                {
+                        scut_suite_cache(s, 1);
+                }
+                if (strcmp(a, "--force") == 0)
+                {
+                        scut_suite_cache(s, 2);
+                }
+                if (strcmp(a, "--fail-fast") == 0)
+                {
+                        scut_suite_fail_fast(s, 1);
+                }
+                if (strncmp(a, "--fail-fast=", 12) == 0)
+                {
+                        int n;
+
+                        if (parse_count(a + 12, 1, &n))
+                        {
+                                fprintf(stderr, 
+                                        "Invalid fail-fast %s\n", 
+                                        a + 12);
+                                return 1;
+                        }
+                        scut_suite_fail_fast(s, n);
+                }
+
+                if (strncmp(a, "--shard=", 8) == 0)
+                {
+                        int index;
+                        int total;
+                        char c;
+
+                        if (sscanf(a + 8, "%d/%d%c", &index, &total, &c) != 2 ||
+                            scut_suite_shard(s, index, total))
+                        {
+                                fprintf(stderr, "Invalid shard %s\n", a + 8);
+                                return 1;
+                        }
+                }
+        }
+
+        return 0;
+}
+
+int scut_suite_num_tests(scut_suite_t* s)
+{
+        return s->units;
+}
+
+int scut_suite_run(scut_suite_t* s, int flags)
+{
+        static pthread_once_t once = PTHREAD_ONCE_INIT;
+        struct scut_run* run;
+        int forked;
+        int jobs;
+        int count;
+        int failed;
+        int invalid = 0;
+
+        run = malloc(sizeof(struct scut_run));
+        if (run == NULL)
+        {
+                return s->units;
+        }
+
+        /* Report output is buffered, keep it if a test calls exit */
+        pthread_once(&once, &flush_at_exit_setup);
+
+        memset(run, 0, sizeof(*run));
+        run->suite = s;
+        run->prev = cur;
+        run->flags = flags;
+        run->fd = -1;
+        run->reporter = get_reporter(flags);
+        cur = run;
+        run->history = s->history ? s->history : getenv("SCUT_HISTORY");
+        if (run->history && *run->history == 0)
+        {
+                run->history = NULL;
+        }
+        run->failed_first = s->failed_first ? 
+                s->failed_first > 0 : env_int("SCUT_FAILED_FIRST") > 0;
+        run->fail_fast = s->fail_fast;
+        if (run->fail_fast == 0 && 
+            env_count("SCUT_FAIL_FAST", &run->fail_fast))
+        {
+                invalid = 1;
+        }
+        if (env_count("SCUT_TIMEOUT", &run->env_timeout) ||
+            env_count("SCUT_JOBS", &run->env_jobs) ||
+            env_count("SCUT_SLOWEST", &run->slowest_cap))
+        {
+                invalid = 1;
+        }
+        run->isolate = s->isolate;
+        if (run->isolate == 0 && env_count("SCUT_ISOLATE", &run->isolate))
+        {
+                invalid = 1;
+        }
+        if (run->isolate < 0)
+        {
+                run->isolate = 0;
+        }
+        if (env_int("SCUT_ALLOCS") > 0)
+        {
+                run->flags |= SCUT_ALLOCS;
+        }
+        if (env_int("SCUT_PERF") > 0)
+        {
+                run->flags |= SCUT_PERF;
+        }
+        if ((s->cache ? s->cache : env_int("SCUT_CACHE")) > 0)
+        {
+                /* Forcing a full run still refreshes the cache */
+                run->id = binary_id();
+                if (s->cache == 2 || env_int("SCUT_FORCE") > 0)
+                {
+                        run->num_cached = -1;
+                }
+        }
+        if ((run->failed_first || run->id) && run->history == NULL)
+        {
+                /* Last outcomes are needed, keep them by default */
+                run->history = HISTORY;
+        }
+        if (invalid || select_tests())
+        {
+                cur = run->prev;
+                free(run->order);
+                free(run->dispatch);
+                free(run->first);
+                free(run->took);
+                free(run->cached);
+                timing_free(&run->timings);
+                if (run->merged.gl_pathv)
+                {
+                        globfree(&run->merged);
+                }
+                free(run);
+                return s->units;
+        }
+        idle_signals(&run->idle_mask);
+        pthread_sigmask(SIG_BLOCK, &run->idle_mask, &run->old_mask);
+        pthread_sigmask(SIG_SETMASK, NULL, &run->idle_mask);
+        run->sigmask = run->old_mask;
+        unblock_idle(&run->sigmask);
+        if (getenv("SCUT_SLOWEST") == NULL && (flags & SCUT_STATS))
+        {
+                run->slowest_cap = SLOWEST;
+        }
+        if (run->slowest_cap > 0)
+        {
+                run->slowest = malloc(sizeof(struct scut_slow) * 
+                                      run->slowest_cap);
+                if (run->slowest == NULL)
+                {
+                        run->slowest_cap = 0;
+                }
+        }
+        run->baseline = s->baseline ? s->baseline : getenv("SCUT_BASELINE");
+        if (run->baseline && *run->baseline)
+        {
+                run->baseline_save = s->baseline_save ? 
+                        s->baseline_save > 0 : env_int("SCUT_BASELINE_SAVE") > 0;
+                run->tolerance = getenv("SCUT_TOLERANCE") ? 
+                        strtod(getenv("SCUT_TOLERANCE"), NULL) : -1;
+                run->samples = calloc(s->units ? s->units : 1, 
+                                      sizeof(struct scut_sample));
+                if (run->samples == NULL || 
+                    baseline_load(&run->base, run->baseline))
+                {
+                        printf("Failed to read baseline %s\n", run->baseline);
+                        free(run->samples);
+                        run->samples = NULL;
+                }
+        }
+        cur = run;
+
+        /* Disable buffering */
+        setbuf(stdout, NULL);
+
+        /* Workers capture their own stdout */
+        jobs = get_jobs(flags);
+        forked = jobs > 1 || run->isolate;
+        if (!forked && (run->fd = capture_start()) < 0)
+        {
+                printf("Failed to capture stdout\n");
+        }
+
+        run->reporter->suite_start();
+
+        if (forked)
+        {
+                failed = run_parallel(jobs);
+        }
+        else
+        {
+                failed = run_serial(run->fd);
+        }
+
+        count = run->count - run->skipped;
+        run->reporter->suite_end(count, failed);
+        flush(1);
+
+        if (!forked)
+        {
+                capture_stop(run->fd);
+        }
+        fixtures_teardown();
+
+        if (run->took && history_save())
+        {
+                printf("Failed to write history %s\n", run->history);
+        }
+        if (run->samples && baseline_update())
+        {
+                printf("Failed to write baseline %s\n", run->baseline);
+        }
+
+        perf_close();
+        pthread_sigmask(SIG_SETMASK, &run->old_mask, NULL);
+        cur = run->prev;
+        free(run->order);
+        free(run->dispatch);
+        free(run->first);
+        free(run->took);
+        free(run->cached);
+        free(run->built);
+        timing_free(&run->timings);
+        if (run->merged.gl_pathv)
+        {
+                globfree(&run->merged);
+        }
+        free(run->samples);
+        timing_free(&run->base);
+        free(run->slowest);
+        free(run->body.data);
+        free(run);
+
+        return failed;
+}
+
+void scut_create(const char* name)
+{
+        if (suite)
+        {
+                scut_destroy();
+        }
+
+        suite = scut_suite_new(name);
+}
+
+int scut_add(int (*test)(void), const char* name)
+{
+        return scut_suite_add_timeout(suite, test, name, 0);
+}
+
+int scut_add_timeout(int (*test)(void), const char* name, int ms)
+{
+        return scut_suite_add_timeout(suite, test, name, ms);
+}
+
+int scut_add_bench(int (*bench)(struct scut_bench*), const char* name)
+{
+        return scut_suite_add_bench(suite, bench, name);
+}
+
+int scut_add_prop(int (*prop)(struct scut_prop*), 
+                  const char* name, 
+                  int cases, 
+                  int ms)
+{
+        return scut_suite_add_prop(suite, prop, name, cases, ms);
+}
+
+int scut_add_param(int (*test)(const void*), 
+                   const char* name,
+                   const void* table,
+                   size_t size,
+                   int n)
+{
+        return scut_suite_add_param(suite, test, name, table, size, n);
+}
+
+void scut_register(struct scut_auto* a)
+{
+        a->next = NULL;
+        if (auto_tail)
+        {
+                auto_tail->next = a;
+        }
+        else
+        {
+                auto_head = a;
+        }
+        auto_tail = a;
+        auto_count++;
+}
+
+int scut_add_all(void)
+{
+        return scut_suite_add_all(suite);
+}
+
+int scut_run(int flags)
+{
+        return scut_suite_run(suite, flags);
+}
+
+void scut_do_not_optimize(const void* p)
+{
+        (void)p;
+}
+
+void scut_timeout(int ms)
+{
+        scut_suite_timeout(suite, ms);
+}
+
+void scut_setup(int (*setup)(void), int (*teardown)(void))
+{
+        scut_suite_setup(suite, setup, teardown);
+}
+
+int scut_use(const struct scut_fixture* fixture)
+{
+        return scut_suite_use(suite, fixture);
+}
+
+void* scut_fixture(const struct scut_fixture* fixture)
+{
+        void* data = NULL;
+        int depth;
+        int err;
+
+        if (cur == NULL)
+        {
+                return NULL;
+        }
+        /* The fixture outlives the test, it is not the test's leak */
+        depth = alloc_pause();
+        err = fixture_get(fixture, &data);
+        alloc_resume(depth);
+
+        return err ? NULL : data;
+}
+
+/* Threads started by a test use the run of that test */
+void scut_expect_sig(int signum)
+{
+        struct scut_run* run = cur && cur->in_test ? cur : test_run;
+
+        if (run)
+        {
+                sigaddset(&run->sig_expected, signum);
+        }
+}
+
+int scut_assert_sig(int signum)
+{
+        struct scut_run* run = cur && cur->in_test ? cur : test_run;
+
+        return run && sigismember(&run->sig_caught, signum) == 1;
+}
+
+int scut_mem_eq(const void* found, 
+                const void* expected, 
+                size_t n, 
+                size_t size, 
+                const char* file, 
+                int line)
+{
+        const unsigned char* a = found;
+        const unsigned char* b = expected;
+        size_t first = n;
+        size_t differ = 0;
+        size_t start;
+
+        if (n == 0 || a == b || memcmp(a, b, n) == 0)
+        {
+                return 1;
+        }
+
+        for (size_t off = 0; off < n; off += MEM_CHUNK)
+        {
+                size_t len = n - off < MEM_CHUNK ? n - off : MEM_CHUNK;
+
+                if (memcmp(a + off, b + off, len) == 0)
+                {
+                        continue;
+                }
+                if (first == n)
+                {
+                        first = off + mem_first(a + off, b + off, len);
+                }
+                differ += mem_count(a + off, b + off, len);
+        }
+
+        printf("Assertion error, buffers differ at offset %zu", first);
+        if (size > 1)
+        {
+                printf(" (element %zu)", first / size);
+        }
+        printf(", %zu of %zu bytes differ: %s+%d\n", differ, n, file, line);
+        start = first / 16 * 16;
+        start = start >= 16 ? start - 16 : 0;
+        for (size_t row = start; 
+             row < n && row < start + MEM_ROWS * 16; 
+             row += 16)
+        {
+                mem_dump(a, b, n, row);
+        }
+
+        return 0;
+}
+
+int scut_float_eq(const void* found, 
+                  const void* expected, 
+                  size_t n, 
+                  size_t size, 
+                  int kind, 
+                  double tol, 
+                  const char* file, 
+                  int line)
+{
+        static const double abs_bounds[FLOAT_BUCKETS] = {
+                1e-15, 1e-12, 1e-9, 1e-6, 1e-3, 1
+        };
+        static const double ulp_bounds[FLOAT_BUCKETS] = {
+                1, 4, 16, 256, 4096, 65536
+        };
+        const double* bounds = kind == SCUT_TOL_ULP ? ulp_bounds : abs_bounds;
+        size_t buckets[FLOAT_BUCKETS + 2] = {0};
+        int single = size == sizeof(float);
+        int digits = single ? 9 : 17;
+        const char* sep = " ";
+        char limit[64];
+        double worst = -1;
+        double sum = 0;
+        size_t worst_i = 0;
+        size_t over = 0;
+
+        if (size != sizeof(float) && size != sizeof(double))
+        {
+                printf("Assertion error, elements of %zu bytes are not float or double: %s+%d\n", 
+                       size, 
+                       file, 
+                       line);
+                return 0;
+        }
+        if (n == 0 || found == expected || 
+            !float_over(found, expected, n, size, kind, tol))
+        {
+                return 1;
+        }
+
+        /* Only on a failure, look at every element again */
+        for (size_t i = 0; i < n; ++i)
+        {
+                double x = float_at(found, size, i);
+                double y = float_at(expected, size, i);
+                double e = float_error(x, y, single, kind);
+                int b = 0;
+
+                if (e > tol)
+                {
+                        over++;
+                }
+                if (e > worst)
+                {
+                        worst = e;
+                        worst_i = i;
+                }
+                sum += e;
+                if (e > 0)
+                {
+                        while (b < FLOAT_BUCKETS && e > bounds[b])
+                        {
+                                b++;
+                        }
+                        b++;
+                }
+                buckets[b]++;
+        }
+        if (over == 0)
+        {
+                return 1;
+        }
+
+        float_tol(limit, sizeof(limit), kind, tol);
+        printf("Assertion error, %zu of %zu elements differ by more than %s: %s+%d\n", 
+               over, 
+               n, 
+               limit, 
+               file, 
+               line);
+        printf("  worst at index %zu: found %.*g, expected %.*g, error %.*g\n", 
+               worst_i, 
+               digits, 
+               float_at(found, size, worst_i), 
+               digits, 
+               float_at(expected, size, worst_i), 
+               FLOAT_ERROR_DIGITS(kind), 
+               worst);
+        printf("  mean error %g, errors", sum / n);
+        for (int b = 0; b < FLOAT_BUCKETS + 2; ++b)
+        {
+                if (buckets[b] == 0)
+                {
+                        continue;
+                }
+                if (b == 0)
+                {
+                        printf("%s0: %zu", sep, buckets[b]);
+                }
+                else if (b <= FLOAT_BUCKETS)
+                {
+                        printf("%s<=%g: %zu", sep, bounds[b - 1], buckets[b]);
+                }
+                else
+                {
+                        printf("%s>%g: %zu", sep, bounds[b - 2], buckets[b]);
+                }
+                sep = ", ";
+        }
+        printf("\n");
+
+        return 0;
+}
+
+int scut_near(double found, 
+              double expected, 
+              int single, 
+              int kind, 
+              double tol, 
+              const char* file, 
+              int line)
+{
+        int digits = single ? 9 : 17;
+        double e = float_error(found, expected, single, kind);
+        char limit[64];
+
+        if (!(e > tol))
+        {
+                return 1;
+        }
+        float_tol(limit, sizeof(limit), kind, tol);
+        printf("Assertion error, found %.*g, expected %.*g, error %.*g is more than %s: %s+%d\n", 
+               digits, 
+               found, 
+               digits, 
+               expected, 
+               FLOAT_ERROR_DIGITS(kind), 
+               e, 
+               limit, 
+               file, 
+               line);
+
+        return 0;
+}
+
+void scut_expect_ie(long long found, 
+                    long long expected, 
+                    const char* expr, 
+                    const char* file, 
+                    int line)
+{
+        struct scut_failure f;
+
+        memset(&f, 0, sizeof(f));
+        f.kind = FAIL_IE;
+        f.found = found;
+        f.expected = expected;
+        f.expr = expr;
+        f.file = file;
+        f.line = line;
+        fail_add(&f);
+}
+
+void scut_expect_bool(int expected, 
+                      const char* expr, 
+                      const char* file, 
+                      int line)
+{
+        struct scut_failure f;
+
+        memset(&f, 0, sizeof(f));
+        f.kind = FAIL_BOOL;
+        f.expected = expected;
+        f.expr = expr;
+        f.file = file;
+        f.line = line;
+        fail_add(&f);
+}
+
+void scut_expect_near(double found, 
+                      double expected, 
+                      int single, 
+                      int kind, 
+                      double tol, 
+                      const char* expr, 
+                      const char* file, 
+                      int line)
+{
+        struct scut_failure f;
+
+        if (!(float_error(found, expected, single, kind) > tol))
+        {
+                return;
+        }
+        memset(&f, 0, sizeof(f));
+        f.kind = FAIL_NEAR;
+        f.x = found;
+        f.y = expected;
+        f.tol = tol;
+        f.tol_kind = kind;
+        f.single = single;
+        f.expr = expr;
+        f.file = file;
+        f.line = line;
+        fail_add(&f);
+}
+
+int scut_stress(int threads, 
+                long long iterations, 
+                int (*fn)(int, long long), 
+                const char* file, 
+                int line)
+{
+        struct scut_stress_thread* t;
+        struct scut_stress_run run;
+        struct scut_stress res;
+        pthread_condattr_t attr;
+        sigset_t alarm;
+        sigset_t mask;
+        long long deadline = cur && cur->in_test ? cur->deadline : 0;
+        long long start;
+        int first = -1;
+        int started = 0;
+
+        if (threads < 1 || 
+            (t = calloc(threads, sizeof(struct scut_stress_thread))) == NULL)
+        {
+                printf("Stress error, cannot run %d threads: %s+%d\n", 
+                       threads, 
+                       file, 
+                       line);
+                return 1;
+        }
+
+        /* 
+         * The watchdog must not jump out while the threads use run and t.
+         * It is held off here, and in the threads which inherit the mask,
+         * and the deadline is kept by waiting for the threads instead.
+         */
+        sigemptyset(&alarm);
+        sigaddset(&alarm, SIGALRM);
+        pthread_sigmask(SIG_BLOCK, &alarm, &mask);
+
+        run.fn = fn;
+        run.iterations = iterations;
+        run.ready = 0;
+        run.go = 0;
+        run.finished = 0;
+        run.stop = 0;
+        pthread_mutex_init(&run.lock, NULL);
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&run.cond, &attr);
+        pthread_condattr_destroy(&attr);
+        for (; started < threads; ++started)
+        {
+                t[started].run = &run;
+                t[started].thread = started;
+                if (pthread_create(&t[started].tid, 
+                                   NULL, 
+                                   stress_thread, 
+                                   t + started))
+                {
+                        break;
+                }
+        }
+
+        /* Open the gate when all are waiting, or to let them go on error */
+        pthread_mutex_lock(&run.lock);
+        while (run.ready < started)
+        {
+                pthread_cond_wait(&run.cond, &run.lock);
+        }
+        run.go = started < threads ? -1 : 1;
+        start = now_ns();
+        pthread_cond_broadcast(&run.cond);
+
+        /* Stop the threads if the test runs out of time */
+        while (run.finished < started)
+        {
+                struct timespec ts;
+
+                if (deadline == 0 || run.stop)
+                {
+                        pthread_cond_wait(&run.cond, &run.lock);
+                        continue;
+                }
+                ts.tv_sec = deadline / 1000000000LL;
+                ts.tv_nsec = deadline % 1000000000LL;
+                if (pthread_cond_timedwait(&run.cond, &run.lock, &ts) == 
+                    ETIMEDOUT)
+                {
+#if defined(__GNUC__)
+                        __atomic_store_n(&run.stop, 1, __ATOMIC_RELAXED);
+#else
+                        run.stop = 1;
+#endif
+                }
+        }
+        pthread_mutex_unlock(&run.lock);
+
+        memset(&res, 0, sizeof(res));
+        res.threads = threads;
+        for (int i = 0; i < started; ++i)
+        {
+                pthread_join(t[i].tid, NULL);
+        }
+        res.ns = now_ns() - start;
+        for (int i = 0; i < started; ++i)
+        {
+                res.iterations += t[i].done;
+                if (t[i].failed)
+                {
+                        res.failed++;
+                        first = first < 0 ? i : first;
+                }
+        }
+        pthread_cond_destroy(&run.cond);
+        pthread_mutex_destroy(&run.lock);
+        if (run.stop)
+        {
+                /* All threads are done, time out as the watchdog would */
+                free(t);
+                pthread_sigmask(SIG_SETMASK, &mask, NULL);
+                longjmp(cur->env, JMP_TIMEOUT);
+        }
+        pthread_sigmask(SIG_SETMASK, &mask, NULL);
+
+        if (started < threads)
+        {
+                printf("Stress error, started %d of %d threads: %s+%d\n", 
+                       started, 
+                       threads, 
+                       file, 
+                       line);
+                free(t);
+                return 1;
+        }
+        if (cur && cur->in_test)
+        {
+                cur->has_stress = 1;
+                cur->stress = res;
+        }
+        if (res.failed && t[first].sig)
+        {
+                printf("Stress error, %d of %d threads failed, the first at iteration %lld of thread %d with signal %d: %s+%d\n", 
+                       res.failed, 
+                       threads, 
+                       t[first].done, 
+                       first, 
+                       t[first].sig, 
+                       file, 
+                       line);
+        }
+        else if (res.failed)
+        {
+                printf("Stress error, %d of %d threads failed, the first at iteration %lld of thread %d: %s+%d\n", 
+                       res.failed, 
+                       threads, 
+                       t[first].done, 
+                       first, 
+                       file, 
+                       line);
+        }
+        free(t);
+
+        return res.failed > 0;
+}
+
+long long scut_perf_begin(int event)
+{
+        struct scut_perf p;
+
+        if (cur == NULL || event < 0 || event >= PERF_EVENTS)
+        {
+                return 0;
+        }
+        perf_read(&p);
+
+        return p.v[event] > 0 ? p.v[event] : 0;
+}
+
+long long scut_perf_end(int event, 
+                        long long start, 
+                        long long max, 
+                        const char* file, 
+                        int line)
+{
+        static const char* const names[PERF_EVENTS] = {
+                "instructions", "cycles", "cache misses", "branch misses", 
+                "TLB misses", "ns of task clock", "page faults", 
+                "context switches"
+        };
+        struct scut_perf p;
+        long long n;
+
+        if (cur == NULL || event < 0 || event >= PERF_EVENTS)
+        {
+                return -1;
+        }
+        perf_read(&p);
+        n = p.v[event] - start;
+        if (p.v[event] >= 0 && n > max)
+        {
+                printf("Assertion error, %lld %s, expected at most %lld: "
+                       "%s+%d\n", 
+                       n, 
+                       names[event],
+                       max, 
+                       file, 
+                       line);
+                return -2;
+        }
+
+        return -1;
+}
+
+long long scut_alloc_begin(void)
+{
+        alloc_track(1);
+
+        return alloc_total;
+}
+
+long long scut_alloc_end(long long start, 
+                         long long max, 
+                         const char* file, 
+                         int line)
+{
+        long long n;
+
+        alloc_track(0);
+        n = alloc_total - start;
+        if (n > max)
+        {
+                printf("Assertion error, %lld allocations, expected at most "
+                       "%lld: %s+%d\n", 
+                       n, 
+                       max, 
+                       file, 
+                       line);
+                return -2;
+        }
+
+        return -1;
+}
+
+int scut_filter(const char* filter)
+{
+        return scut_suite_filter(suite, filter);
+}
+
+int scut_shard(int index, int total)
+{
+        return scut_suite_shard(suite, index, total);
+}
+
+int scut_history(const char* path)
+{
+        return scut_suite_history(suite, path);
+}
+
+void scut_failed_first(int on)
+{
+        scut_suite_failed_first(suite, on);
+}
+
+void scut_fail_fast(int n)
+{
+        scut_suite_fail_fast(suite, n);
+}
+
+void scut_cache(int on)
+{
+        scut_suite_cache(suite, on);
+}
+
+void scut_isolate(int n)
+{
+        scut_suite_isolate(suite, n);
+}
+
+int scut_baseline(const char* path, int save)
+{
+        return scut_suite_baseline(suite, path, save);
+}
+
+int scut_no_regression(double tolerance)
+{
+        return scut_suite_no_regression(suite, tolerance);
+}
+
+int scut_args(int argc, char** argv)
+{
+        return scut_suite_args(suite, argc, argv);
+}
+
+int scut_num_tests(void)
+{
+        return scut_suite_num_tests(suite);
+}
+
+void scut_destroy(void)
+{
+        scut_suite_free(suite);
+        suite = NULL;
+}
+
+static int add(struct scut_suite* s,
+               int (*test)(void), 
+               int (*bench)(struct scut_bench*), 
+               const char* name, 
+               int ms)
+{
+        if (name == NULL)
+        {
+                return 1;
+        }
+
+        if (reserve(s, s->count + 1))
+        {
+                return 1;
+        }
+
+        s->tests[s->count].test = test;
+        s->tests[s->count].bench = bench;
+        s->tests[s->count].param = NULL;
+        s->tests[s->count].table = NULL;
+        s->tests[s->count].size = 0;
+        s->tests[s->count].cases = 1;
+        s->tests[s->count].prop = NULL;
+        s->tests[s->count].prop_cases = 0;
+        s->tests[s->count].prop_ms = 0;
+        s->tests[s->count].fixtures = NULL;
+        s->tests[s->count].num_fixtures = 0;
+        s->tests[s->count].name = name;
+        s->tests[s->count].timeout = ms;
+        s->tests[s->count].tolerance = -1;
+        s->tests[s->count].unit = s->units;
+        s->tests[s->count].index = -1;
+        s->count++;
+        s->units++;
+
+        return 0;
+}
+
+/*
+ * Make room for at least n tests. The capacity is doubled, so adding
+ * tests one by one is amortized constant time.
+ */
+static int reserve(struct scut_suite* s, int n)
+{
+        struct scut_test* tests;
+        int cap = s->cap;
+
+        if (n <= cap)
+        {
+                return 0;
+        }
+
+        while (cap < n)
+        {
+                cap *= 2;
+        }
+        tests = realloc(s->tests, sizeof(struct scut_test) * cap);
+        if (tests == NULL)
+        {
+                return 1;
+        }
+        s->tests = tests;
+        s->cap = cap;
+
+        return 0;
+}
+
+static struct scut_test* test_at(int i)
+{
+        return test_unit(cur->order[i]);
+}
+
+/*
+ * Each case of a parameterized test is a unit of its own, filtered,
+ * sharded and scheduled like any test. The test for a unit is made when
+ * asked for, and is only valid until the next call.
+ */
+static struct scut_test* test_unit(int u)
+{
+        struct scut_suite* s = cur->suite;
+        int lo = 0;
+        int hi = s->count - 1;
+
+        if (cur->first == NULL)
+        {
+                return s->tests + u;
+        }
+        while (lo < hi)
+        {
+                int mid = (lo + hi + 1) / 2;
+
+                if (cur->first[mid] <= u)
+                {
+                        lo = mid;
+                }
+                else
+                {
+                        hi = mid - 1;
+                }
+        }
+        cur->at = s->tests[lo];
+        cur->at.unit = u;
+        if (cur->at.param)
+        {
+                cur->at.index = u - cur->first[lo];
+                snprintf(cur->at_name, 
+                         MAX_MSG, 
+                         "%s[%d]", 
+                         cur->at.name, 
+                         cur->at.index);
+                cur->at.name = cur->at_name;
+        }
+
+        return &cur->at;
+}
+
+/*
+ * Pick the tests this run executes: those matching the filter, and of
+ * those the ones belonging to this shard. Tests left out never get
+ * further than this. With a duration history, shards are balanced by
+ * expected time, and workers are handed the longest tests first.
+ */
+static int select_tests(void)
+{
+        struct scut_suite* s = cur->suite;
+        const char* filter = s->filter ? s->filter : getenv("SCUT_FILTER");
+        struct scut_est* est;
+        int n = s->units ? s->units : 1;
+        int index;
+        int total;
+        int matched;
+        int count = 0;
+
+        if (get_shard(&index, &total))
+        {
+                return 1;
+        }
+        cur->shard = total > 1 ? index : -1;
+
+        cur->order = malloc(sizeof(int) * n);
+        cur->dispatch = malloc(sizeof(int) * n);
+        est = malloc(sizeof(struct scut_est) * n);
+        if (!cur->order || !cur->dispatch || !est)
+        {
+                free(est);
+                return 1;
+        }
+
+        if (s->units != s->count)
+        {
+                cur->first = malloc(sizeof(int) * s->count);
+                if (cur->first == NULL)
+                {
+                        free(est);
+                        return 1;
+                }
+                for (int i = 0; i < s->count; ++i)
+                {
+                        cur->first[i] = i ? 
+                                cur->first[i - 1] + s->tests[i - 1].cases : 0;
+                }
+        }
+
+        for (int i = 0; i < s->units; ++i)
+        {
+                if (filter && *filter && 
+                    !filter_match(filter, test_unit(i)->name))
+                {
+                        continue;
+                }
+                cur->order[count] = i;
+                est[count].ns = -1;
+                est[count].pos = count;
+                est[count].failed = 0;
+                count++;
+        }
+        matched = count;
+
+        if (cur->history)
+        {
+                cur->took = malloc(sizeof(struct scut_timing) * n);
+                if (cur->took == NULL || 
+                    timing_load(&cur->timings, cur->history) ||
+                    (cur->shard < 0 && history_merge()))
+                {
+                        free(est);
+                        return 1;
+                }
+                for (int i = 0; i < s->units; ++i)
+                {
+                        cur->took[i].ns = -1;
+                }
+        }
+        if (cur->timings.len)
+        {
+                long long sum = 0;
+                int known = 0;
+
+                /* Tests without history are expected to take the average */
+                for (int i = 0; i < count; ++i)
+                {
+                        struct scut_timing* t = 
+                                timing_find(&cur->timings, test_at(i)->name);
+
+                        if (t->name)
+                        {
+                                est[i].ns = t->ns;
+                                sum += t->ns;
+                                known++;
+                        }
+                }
+                for (int i = 0; i < count; ++i)
+                {
+                        if (est[i].ns < 0)
+                        {
+                                est[i].ns = known ? sum / known : 0;
+                        }
+                }
+                qsort(est, count, sizeof(struct scut_est), &est_cmp);
+                if (total > 1)
+                {
+                        count = shard_lpt(est, count, index, total);
+                }
+        }
+        else if (total > 1)
+        {
+                int kept = 0;
+
+                for (int i = index; i < count; i += total)
+                {
+                        est[kept++].pos = i;
+                }
+                count = kept;
+        }
+
+        /* 
+         * Keep the suite order for reporting, est is the dispatch order.
+         * dispatch maps old positions to est here, then is filled in.
+         */
+        for (int i = 0; i < matched; ++i)
+        {
+                cur->dispatch[i] = -1;
+        }
+        for (int k = 0; k < count; ++k)
+        {
+                cur->dispatch[est[k].pos] = k;
+        }
+        cur->count = 0;
+        for (int i = 0; i < matched; ++i)
+        {
+                if (cur->dispatch[i] >= 0)
+                {
+                        cur->order[cur->count] = cur->order[i];
+                        est[cur->dispatch[i]].pos = cur->count++;
+                }
+        }
+        if (cur->failed_first && failed_first(est, count))
+        {
+                free(est);
+                return 1;
+        }
+        for (int k = 0; k < count; ++k)
+        {
+                cur->dispatch[k] = est[k].pos;
+        }
+        free(est);
+
+        /* Tests that passed with this very executable need not run again */
+        if (cur->id && cur->num_cached == 0)
+        {
+                cur->cached = calloc(n, 1);
+                if (cur->cached == NULL)
+                {
+                        return 1;
+                }
+                for (int i = 0; i < count; ++i)
+                {
+                        struct scut_timing* t = 
+                                timing_find(&cur->timings, test_at(i)->name);
+
+                        if (t->name && !t->failed && t->id && 
+                            !test_at(i)->bench && strcmp(t->id, cur->id) == 0)
+                        {
+                                cur->cached[i] = 1;
+                                cur->num_cached++;
+                        }
+                }
+        }
+        if (cur->num_cached < 0)
+        {
+                cur->num_cached = 0;
+        }
+
+        return 0;
+}
+
+/*
+ * Longest processing time first: each test, longest first, goes to the
+ * shard with the least expected time so far. Every shard computes the
+ * same assignment from the same history, and keeps its own tests.
+ */
+static int shard_lpt(struct scut_est* est, int count, int index, int total)
+{
+        long long* load = calloc(total, sizeof(long long));
+        int kept = 0;
+
+        if (load == NULL)
+        {
+                return 0;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+                int min = 0;
+
+                for (int j = 1; j < total; ++j)
+                {
+                        if (load[j] < load[min])
+                        {
+                                min = j;
+                        }
+                }
+                /* Count each test as at least 1 ns, so ties spread out */
+                load[min] += est[i].ns > 0 ? est[i].ns : 1;
+                if (min == index)
+                {
+                        est[kept++] = est[i];
+                }
+        }
+        free(load);
+
+        return kept;
+}
+
+/*
+ * Move the tests that failed last time to the front, both in the order
+ * they are run and reported, and in the order they are dispatched.
+ */
+static int failed_first(struct scut_est* est, int count)
+{
+        int* moved;
+        int* flag;
+        int any = 0;
+        int j = 0;
+
+        for (int k = 0; k < count; ++k)
+        {
+                struct scut_timing* t = 
+                        timing_find(&cur->timings, test_at(est[k].pos)->name);
+
+                est[k].failed = t->name && t->failed;
+                any |= est[k].failed;
+        }
+        if (!any)
+        {
+                return 0;
+        }
+
+        moved = malloc(sizeof(int) * count * 2);
+        if (moved == NULL)
+        {
+                return 1;
+        }
+        flag = moved + count;
+        for (int k = 0; k < count; ++k)
+        {
+                flag[est[k].pos] = est[k].failed;
+        }
+        /* moved maps old positions to new ones, flag turns into order */
+        for (int pass = 1; pass >= 0; --pass)
+        {
+                for (int i = 0; i < count; ++i)
+                {
+                        if (flag[i] == pass)
+                        {
+                                moved[i] = j++;
+                        }
+                }
+        }
+        for (int i = 0; i < count; ++i)
+        {
+                flag[moved[i]] = cur->order[i];
+        }
+        for (int i = 0; i < count; ++i)
+        {
+                cur->order[i] = flag[i];
+        }
+        for (int k = 0; k < count; ++k)
+        {
+                est[k].pos = moved[est[k].pos];
+        }
+        qsort(est, count, sizeof(struct scut_est), &est_cmp);
+        free(moved);
+
+        return 0;
+}
+
+/* Failed first if asked for, then longest first, then in suite order */
+static int est_cmp(const void* a, const void* b)
+{
+        const struct scut_est* x = a;
+        const struct scut_est* y = b;
+
+        if (x->failed != y->failed)
+        {
+                return y->failed - x->failed;
+        }
+        if (x->ns != y->ns)
+        {
+                return x->ns > y->ns ? -1 : 1;
+        }
+
+        return x->pos - y->pos;
+}
+
+/*
+ * A filter is a comma separated list of glob patterns, see fnmatch(3). 
+ * Patterns starting with '-' exclude tests. A test is selected if it
+ * matches no exclude pattern, and any include pattern if there are any.
+ */
+static int filter_match(const char* filter, const char* name)
+{
+        char pat[MAX_MSG];
+        int include = 0;
+        int included = 0;
+
+        while (*filter)
+        {
+                size_t len = strcspn(filter, ",");
+                const char* p = filter;
+                int exclude = *p == '-';
+
+                if (exclude)
+                {
+                        p++;
+                }
+                if ((size_t)(filter + len - p) < sizeof(pat))
+                {
+                        memcpy(pat, p, filter + len - p);
+                        pat[filter + len - p] = 0;
+                        if (fnmatch(pat, name, 0) == 0)
+                        {
+                                if (exclude)
+                                {
+                                        return 0;
+                                }
+                                included = 1;
+                        }
+                }
+                include |= !exclude && filter + len > p;
+                filter += len + (filter[len] == ',');
+        }
+
+        return included || !include;
+}
+
+/*
+ * The history file has one line per test: the expected duration in
+ * nanoseconds, "pass" or "fail" for the last outcome, optionally @ and
+ * the identity of the executable, and the name. A missing file is an
+ * empty history.
+ */
+static int timing_load(struct scut_timings* t, const char* path)
+{
+        FILE* f = fopen(path, "r");
+        char* line = NULL;
+        size_t cap = 0;
+        int ret = 0;
+
+        if (f == NULL)
+        {
+                return errno != ENOENT;
+        }
+
+        while (ret == 0 && getline(&line, &cap, f) > 0)
+        {
+                char* name;
+                long long ns = strtoll(line, &name, 10);
+                const char* id = NULL;
+                int failed = 0;
+                size_t len;
+
+                if (name == line || *name != ' ')
+                {
+                        continue;
+                }
+                name++;
+                if (strncmp(name, "pass ", 5) == 0 || 
+                    strncmp(name, "fail ", 5) == 0)
+                {
+                        failed = *name == 'f';
+                        name += 5;
+                }
+                if (*name == '@')
+                {
+                        id = name + 1;
+                        name += strcspn(name, " ");
+                        if (*name)
+                        {
+                                *name++ = 0;
+                        }
+                }
+                len = strlen(name);
+                if (len > 0 && name[len - 1] == '\n')
+                {
+                        name[len - 1] = 0;
+                }
+                ret = timing_put(t, name, ns, failed, id);
+        }
+        free(line);
+        fclose(f);
+
+        return ret;
+}
+
+/*
+ * Load what sharded runs wrote beside the history. The files are removed
+ * once the merged history is saved, see history_save.
+ */
+static int history_merge(void)
+{
+        char pattern[MAX_MSG];
+        size_t len;
+        int ret;
+
+        len = (size_t)snprintf(pattern, 
+                               sizeof(pattern), 
+                               "%s.shard.*", 
+                               cur->history);
+        if (len >= sizeof(pattern))
+        {
+                return 1;
+        }
+
+        ret = glob(pattern, 0, NULL, &cur->merged);
+        if (ret)
+        {
+                globfree(&cur->merged);
+                memset(&cur->merged, 0, sizeof(cur->merged));
+                return ret != GLOB_NOMATCH;
+        }
+        for (size_t i = 0; i < cur->merged.gl_pathc; ++i)
+        {
+                char* path = cur->merged.gl_pathv[i];
+                char* end;
+
+                /* Leave the temporary files of running shards alone */
+                strtol(path + len - 1, &end, 10);
+                if (end == path + len - 1 || *end)
+                {
+                        *path = 0;
+                        continue;
+                }
+                if (timing_load(&cur->timings, path))
+                {
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+/*
+ * Merge the durations of this run into the history and save it. A
+ * sharded run must not change the file the shards are split by, it
+ * writes the tests it ran to history.shard.N instead.
+ */
+static int history_save(void)
+{
+        struct scut_timings own = {NULL, 0, 0};
+        struct scut_timings* out = cur->shard < 0 ? &cur->timings : &own;
+        char path[MAX_MSG];
+        int ret = 0;
+
+        for (int i = 0; ret == 0 && i < cur->count; ++i)
+        {
+                struct scut_timing* r = cur->took + cur->order[i];
+                struct scut_timing* t = 
+                        timing_find(&cur->timings, test_at(i)->name);
+                long long ns = r->ns;
+
+                if (ns < 0)
+                {
+                        continue;
+                }
+                if (t->name)
+                {
+                        ns = t->ns + (ns - t->ns) / HISTORY_WEIGHT;
+                }
+                ret = timing_put(out, test_at(i)->name, ns, r->failed, cur->id);
+        }
+
+        if (cur->shard < 0)
+        {
+                ret = ret || timing_save(out, cur->history);
+                for (size_t i = 0; ret == 0 && i < cur->merged.gl_pathc; ++i)
+                {
+                        if (*cur->merged.gl_pathv[i])
+                        {
+                                unlink(cur->merged.gl_pathv[i]);
+                        }
+                }
+        }
+        else
+        {
+                ret = ret || 
+                        snprintf(path, 
+                                 sizeof(path), 
+                                 "%s.shard.%d", 
+                                 cur->history, 
+                                 cur->shard) >= (int)sizeof(path) ||
+                        timing_save(out, path);
+        }
+        timing_free(&own);
+
+        return ret;
+}
+
+/* Written to a temporary file first, so readers never see half of it */
+static int timing_save(struct scut_timings* t, const char* path)
+{
+        char tmp[MAX_MSG];
+        FILE* f;
+        int ret = 0;
+
+        if (snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid()) >= 
+            (int)sizeof(tmp))
+        {
+                return 1;
+        }
+
+        f = fopen(tmp, "w");
+        if (f == NULL)
+        {
+                return 1;
+        }
+        for (size_t i = 0; i < t->cap; ++i)
+        {
+                if (t->e[i].name && 
+                    fprintf(f, 
+                            "%lld %s %s%s%s%s\n", 
+                            t->e[i].ns, 
+                            t->e[i].failed ? "fail" : "pass", 
+                            t->e[i].id ? "@" : "",
+                            t->e[i].id ? t->e[i].id : "",
+                            t->e[i].id ? " " : "",
+                            t->e[i].name) < 0)
+                {
+                        ret = 1;
+                }
+        }
+        if (fclose(f) || ret || rename(tmp, path))
+        {
+                unlink(tmp);
+                return 1;
+        }
+
+        return 0;
+}
+
+/* The slot of name, which is empty (name NULL) if it is not there */
+static struct scut_timing* timing_find(struct scut_timings* t, const char* name)
+{
+        static struct scut_timing none;
+        size_t i;
+
+        if (t->cap == 0)
+        {
+                return &none;
+        }
+
+        i = hash_name(name) & (t->cap - 1);
+        while (t->e[i].name && strcmp(t->e[i].name, name))
+        {
+                i = (i + 1) & (t->cap - 1);
+        }
+
+        return t->e + i;
+}
+
+static int timing_put(struct scut_timings* t, 
+                      const char* name, 
+                      long long ns, 
+                      int failed, 
+                      const char* id)
+{
+        struct scut_timing* e;
+
+        /* Keep the table at most half full */
+        if (2 * (t->len + 1) > t->cap)
+        {
+                struct scut_timings grown;
+
+                grown.cap = t->cap ? t->cap * 2 : 64;
+                grown.len = t->len;
+                grown.e = calloc(grown.cap, sizeof(struct scut_timing));
+                if (grown.e == NULL)
+                {
+                        return 1;
+                }
+                for (size_t i = 0; i < t->cap; ++i)
+                {
+                        if (t->e[i].name)
+                        {
+                                *timing_find(&grown, t->e[i].name) = t->e[i];
+                        }
+                }
+                free(t->e);
+                *t = grown;
+        }
+
+        e = timing_find(t, name);
+        if (e->name == NULL)
+        {
+                e->name = malloc(strlen(name) + 1);
+                if (e->name == NULL)
+                {
+                        return 1;
+                }
+                strcpy(e->name, name);
+                t->len++;
+        }
+        e->ns = ns;
+        e->failed = failed;
+        if (e->id == NULL || id == NULL || strcmp(e->id, id))
+        {
+                return set_string(&e->id, id);
+        }
+
+        return 0;
+}
+
+static void timing_free(struct scut_timings* t)
+{
+        for (size_t i = 0; i < t->cap; ++i)
+        {
+                free(t->e[i].name);
+                free(t->e[i].id);
+        }
+        free(t->e);
+        t->e = NULL;
+        t->cap = 0;
+        t->len = 0;
+}
+
+/*
+ * The baseline file has one line per test: the number of timing
+ * samples, their mean and variance in nanoseconds, and the name. A
+ * missing file is an empty baseline.
+ */
+static int baseline_load(struct scut_timings* t, const char* path)
+{
+        FILE* f = fopen(path, "r");
+        char* line = NULL;
+        size_t cap = 0;
+        int ret = 0;
+
+        if (f == NULL)
+        {
+                return errno != ENOENT;
+        }
+
+        while (ret == 0 && getline(&line, &cap, f) > 0)
+        {
+                struct scut_sample sample;
+                char* name;
+                size_t len;
+
+                sample.n = strtoll(line, &name, 10);
+                sample.mean = strtod(name, &name);
+                sample.var = strtod(name, &name);
+                if (sample.n < 1 || *name != ' ')
+                {
+                        continue;
+                }
+                name++;
+                len = strlen(name);
+                if (len > 0 && name[len - 1] == '\n')
+                {
+                        name[len - 1] = 0;
+                }
+                ret = timing_put(t, name, (long long)sample.mean, 0, NULL);
+                timing_find(t, name)->sample = sample;
+        }
+        free(line);
+        fclose(f);
+
+        return ret;
+}
+
+static int baseline_save(struct scut_timings* t, const char* path)
+{
+        char tmp[MAX_MSG];
+        FILE* f;
+        int ret = 0;
+
+        if (snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid()) >= 
+            (int)sizeof(tmp))
+        {
+                return 1;
+        }
+
+        f = fopen(tmp, "w");
+        if (f == NULL)
+        {
+                return 1;
+        }
+        for (size_t i = 0; i < t->cap; ++i)
+        {
+                if (t->e[i].name && 
+                    fprintf(f, 
+                            "%lld %.17g %.17g %s\n", 
+                            t->e[i].sample.n, 
+                            t->e[i].sample.mean, 
+                            t->e[i].sample.var, 
+                            t->e[i].name) < 0)
+                {
+                        ret = 1;
+                }
+        }
+        if (fclose(f) || ret || rename(tmp, path))
+        {
+                unlink(tmp);
+                return 1;
+        }
+
+        return 0;
+}
+
+/*
+ * Add the samples of this run to the baseline. Saving merges them into
+ * what is there, otherwise only tests new to the baseline are added.
+ */
+static int baseline_update(void)
+{
+        int changed = 0;
+
+        for (int i = 0; i < cur->count; ++i)
+        {
+                struct scut_test* test = test_at(i);
+                struct scut_sample* sample = cur->samples + test->unit;
+                struct scut_timing* e = timing_find(&cur->base, test->name);
+
+                if (sample->n == 0 || (e->name && !cur->baseline_save))
+                {
+                        continue;
+                }
+                if (e->name == NULL)
+                {
+                        if (timing_put(&cur->base, test->name, 0, 0, NULL))
+                        {
+                                return 1;
+                        }
+                        e = timing_find(&cur->base, test->name);
+                }
+                sample_merge(&e->sample, sample);
+                changed = 1;
+        }
+
+        return changed ? baseline_save(&cur->base, cur->baseline) : 0;
+}
+
+/*
+ * Take the timing of a passed test, and compare it to the baseline
+ * unless the baseline is being saved. A benchmark has one sample per
+ * batch, other tests one per run.
+ */
+static void baseline_check(struct scut_test* test, struct scut_result* res)
+{
+        struct scut_timing* e;
+
+        if (res->ret || res->timed_out)
+        {
+                return;
+        }
+        if (res->bench.ran)
+        {
+                res->sample.n = (long long)res->bench.batches;
+                res->sample.mean = res->bench.ns_op;
+                res->sample.var = res->bench.var;
+        }
+        else
+        {
+                res->sample.n = 1;
+                res->sample.mean = (double)res->ns;
+                res->sample.var = 0;
+        }
+
+        e = timing_find(&cur->base, test->name);
+        if (cur->baseline_save || e->name == NULL)
+        {
+                return;
+        }
+        res->has_baseline = 1;
+        res->base = e->sample;
+        res->tolerance = test->tolerance >= 0 ? test->tolerance : cur->tolerance;
+        res->confidence = regression_confidence(&res->base, 
+                                                &res->sample, 
+                                                res->tolerance > 0 ? 
+                                                res->tolerance : 0);
+        if (res->tolerance >= 0 && res->confidence >= REGRESSION_CONFIDENCE)
+        {
+                res->regressed = 1;
+                res->ret = 1;
+        }
+}
+
+/* Chan et al., combining the counts, means and variances */
+static void sample_merge(struct scut_sample* a, const struct scut_sample* b)
+{
+        long long n = a->n + b->n;
+        double delta = b->mean - a->mean;
+        double m2 = a->var * (a->n > 1 ? a->n - 1 : 0) + 
+                b->var * (b->n > 1 ? b->n - 1 : 0) + 
+                delta * delta * a->n * b->n / n;
+
+        a->mean += delta * b->n / n;
+        a->var = n > 1 ? m2 / (n - 1) : 0;
+        a->n = n;
+}
+
+/*
+ * One sided Welch t-test of the hypothesis that the current samples are
+ * slower than the baseline by more than the tolerance. Returns the
+ * confidence in it, or -1 if neither side has a spread to test with. A
+ * single sample is assumed to vary as much as the other side.
+ */
+static double regression_confidence(const struct scut_sample* base, 
+                                    const struct scut_sample* now, 
+                                    double tolerance)
+{
+        double limit = base->mean * (1 + tolerance);
+        double vb = base->var;
+        double vn = now->var;
+        double a;
+        double b;
+        double se;
+        double df;
+
+        if (base->n < 2 && now->n < 2)
+        {
+                return -1;
+        }
+        if (base->n < 2)
+        {
+                vb = vn;
+        }
+        if (now->n < 2)
+        {
+                vn = vb;
+        }
+        a = vb * (1 + tolerance) * (1 + tolerance) / base->n;
+        b = vn / now->n;
+        se = sqrt(a + b);
+        if (se == 0)
+        {
+                return now->mean > limit ? 1 : 0;
+        }
+        if (base->n < 2 || now->n < 2)
+        {
+                df = (base->n < 2 ? now->n : base->n) - 1;
+        }
+        else
+        {
+                /* Welch-Satterthwaite */
+                df = (a + b) * (a + b) / 
+                        (a * a / (base->n - 1) + b * b / (now->n - 1));
+        }
+
+        return student_cdf((now->mean - limit) / se, df);
+}
+
+/* Distribution function of Student's t */
+static double student_cdf(double t, double df)
+{
+        double tail = 0.5 * beta_inc(df / 2, 0.5, df / (df + t * t));
+
+        return t > 0 ? 1 - tail : tail;
+}
+
+/*
+ * Regularized incomplete beta function, by its continued fraction with
+ * the modified Lentz method. The fraction converges quickly below the
+ * mean, above it the symmetry I(x; a, b) = 1 - I(1 - x; b, a) is used.
+ */
+static double beta_inc(double a, double b, double x)
+{
+        double front;
+        double f = 1;
+        double c = 1;
+        double d = 0;
+
+        if (x <= 0 || x >= 1)
+        {
+                return x <= 0 ? 0 : 1;
+        }
+        if (x > (a + 1) / (a + b + 2))
+        {
+                return 1 - beta_inc(b, a, 1 - x);
+        }
+
+        front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + 
+                    a * log(x) + b * log(1 - x)) / a;
+        for (int i = 0; i <= 200; ++i)
+        {
+                int m = i / 2;
+                double num;
+
+                if (i == 0)
+                {
+                        num = 1;
+                }
+                else if (i % 2 == 0)
+                {
+                        num = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+                }
+                else
+                {
+                        num = -(a + m) * (a + b + m) * x / 
+                                ((a + 2 * m) * (a + 2 * m + 1));
+                }
+                d = 1 + num * d;
+                d = 1 / (fabs(d) < 1e-30 ? 1e-30 : d);
+                c = 1 + num / c;
+                c = fabs(c) < 1e-30 ? 1e-30 : c;
+                f *= c * d;
+                if (fabs(1 - c * d) < 1e-10)
+                {
+                        break;
+                }
+        }
+
+        return front * (f - 1);
+}
+
+/* FNV-1a */
+static unsigned long long hash_name(const char* name)
+{
+        unsigned long long h = 14695981039346656037ULL;
+
+        while (*name)
+        {
+                h ^= (unsigned char)*name++;
+                h *= 1099511628211ULL;
+        }
+
+        return h;
+}
+
+static char self_id[MAX_MSG];
+
+/* Identity of the running executable, NULL if it cannot be told */
+static const char* binary_id(void)
+{
+        static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+        pthread_once(&once, &binary_id_init);
+
+        return *self_id ? self_id : NULL;
+}
+
+/*
+ * The GNU build-id if the linker put one in, otherwise a FNV-1a hash of
+ * the whole file. The build-id only needs a few small reads.
+ */
+static void binary_id_init(void)
+{
+        unsigned long long h = 14695981039346656037ULL;
+        unsigned char buf[64 * 1024];
+        int fd = open(SELF_EXE, O_RDONLY);
+        ssize_t n;
+
+        if (fd < 0)
+        {
+                return;
+        }
+        if (build_id(fd, self_id, sizeof(self_id)) == 0)
+        {
+                close(fd);
+                return;
+        }
+
+        lseek(fd, 0, SEEK_SET);
+        while ((n = read(fd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR))
+        {
+                for (ssize_t i = 0; i < n; ++i)
+                {
+                        h ^= buf[i];
+                        h *= 1099511628211ULL;
+                }
+        }
+        if (n == 0)
+        {
+                snprintf(self_id, sizeof(self_id), "fnv1a:%016llx", h);
+        }
+        close(fd);
+}
+
+/* Find the NT_GNU_BUILD_ID note through the program headers */
+static int build_id(int fd, char* id, size_t len)
+{
+        unsigned char ident[16];
+        unsigned long long phoff;
+        unsigned long long phentsize;
+        unsigned long long phnum;
+        int wide;
+
+        if (pread_all(fd, (char*)ident, sizeof(ident), 0) || 
+            memcmp(ident, "\177ELF", 4))
+        {
+                return 1;
+        }
+        /* Offsets of the fields differ between ELFCLASS32 and ELFCLASS64 */
+        wide = ident[4] == 2;
+        if (pread_num(fd, wide ? 32 : 28, wide ? 8 : 4, &phoff) ||
+            pread_num(fd, wide ? 54 : 42, 2, &phentsize) ||
+            pread_num(fd, wide ? 56 : 44, 2, &phnum))
+        {
+                return 1;
+        }
+
+        for (unsigned long long i = 0; i < phnum; ++i)
+        {
+                off_t ph = (off_t)(phoff + i * phentsize);
+                unsigned long long type;
+                unsigned long long off;
+                unsigned long long size;
+                unsigned long long pos = 0;
+
+                if (pread_num(fd, ph, 4, &type) || type != 4 /* PT_NOTE */ ||
+                    pread_num(fd, ph + (wide ? 8 : 4), wide ? 8 : 4, &off) ||
+                    pread_num(fd, ph + (wide ? 32 : 16), wide ? 8 : 4, &size))
+                {
+                        continue;
+                }
+                while (pos + 12 <= size)
+                {
+                        unsigned long long namesz;
+                        unsigned long long descsz;
+                        unsigned long long ntype;
+                        unsigned char desc[64];
+                        char name[4];
+
+                        if (pread_num(fd, off + pos, 4, &namesz) ||
+                            pread_num(fd, off + pos + 4, 4, &descsz) ||
+                            pread_num(fd, off + pos + 8, 4, &ntype))
+                        {
+                                break;
+                        }
+                        pos += 12;
+                        if (ntype == NT_BUILD_ID && namesz == 4 && 
+                            descsz <= sizeof(desc) && 2 * descsz + 10 <= len &&
+                            pread_all(fd, name, 4, off + pos) == 0 &&
+                            memcmp(name, "GNU", 4) == 0 &&
+                            pread_all(fd, (char*)desc, descsz, off + pos + 4) == 0)
+                        {
+                                int n = snprintf(id, len, "build-id:");
+
+                                for (unsigned long long j = 0; j < descsz; ++j)
+                                {
+                                        n += snprintf(id + n, len - n, "%02x", desc[j]);
+                                }
+                                return 0;
+                        }
+                        pos += (namesz + 3) / 4 * 4 + (descsz + 3) / 4 * 4;
+                }
+        }
+
+        return 1;
+}
+
+/* Read a native endian unsigned number of 2, 4 or 8 bytes */
+static int pread_num(int fd, off_t off, int size, unsigned long long* v)
+{
+        unsigned short u16;
+        unsigned int u32;
+
+        switch (size)
+        {
+        case 2:
+                if (pread_all(fd, (char*)&u16, 2, off))
+                {
+                        return 1;
+                }
+                *v = u16;
+                return 0;
+        case 4:
+                if (pread_all(fd, (char*)&u32, 4, off))
+                {
+                        return 1;
+                }
+                *v = u32;
+                return 0;
+        default:
+                return pread_all(fd, (char*)v, 8, off);
+        }
+}
+
+static int env_int(const char* name)
+{
+        const char* env = getenv(name);
+
+        return env ? (int)strtol(env, NULL, 10) : 0;
+}
+
+/* A count from the environment, 0 if unset. Returns 1 if malformed. */
+static int env_count(const char* name, int* n)
+{
+        const char* env = getenv(name);
+
+        *n = 0;
+        if (env == NULL || *env == 0)
+        {
+                return 0;
+        }
+        if (parse_count(env, 0, n))
+        {
+                fprintf(stderr, "Invalid %s=%s\n", name, env);
+                return 1;
+        }
+
+        return 0;
+}
+
+/* A decimal number of at least min and nothing else */
+static int parse_count(const char* s, int min, int* n)
+{
+        char* end;
+        long v;
+
+        errno = 0;
+        v = strtol(s, &end, 10);
+        if (end == s || *end || errno || v < min || v > INT_MAX)
+        {
+                return 1;
+        }
+        *n = (int)v;
+
+        return 0;
+}
+
+/* Shard from scut_suite_shard, or SCUT_SHARD_INDEX/SCUT_SHARD_TOTAL */
+static int get_shard(int* index, int* total)
+{
+        *index = cur->suite->shard_index;
+        *total = cur->suite->shard_total;
+        if (*total == 0)
+        {
+                const char* t = getenv("SCUT_SHARD_TOTAL");
+
+                if (env_count("SCUT_SHARD_INDEX", index) ||
+                    env_count("SCUT_SHARD_TOTAL", total))
+                {
+                        return 1;
+                }
+                if (t == NULL || *t == 0)
+                {
+                        *total = 1;
+                }
+        }
+        if (*total < 1 || *index < 0 || *index >= *total)
+        {
+                printf("Invalid shard %d of %d\n", *index, *total);
+                return 1;
+        }
+
+        return 0;
+}
+
+/*
+ * Stdout is redirected to an unlinked temporary file instead of a pipe.
+ * Writes never block however much a test prints, and nothing needs to
+ * be read until the test is done. drain() then only picks up the head
+ * and the tail of the output.
+ */
+static int capture_file(void)
+{
+        FILE* tmp = tmpfile();
+        int fd;
+
+        if (tmp == NULL)
+        {
+                return -1;
+        }
+
+        fd = dup(fileno(tmp));
+        fclose(tmp);
+
+        return fd;
+}
+
+/* 
+ * The capture file is installed as fd 1 by enter_test. The first run
+ * to capture saves the real stdout, and the last one restores it.
+ */
+static int capture_start(void)
+{
+        int fd = capture_file();
+
+        if (fd < 0)
+        {
+                return -1;
+        }
+
+        pthread_mutex_lock(&out_lock);
+        if (captures == 0)
+        {
+                real_out = dup(1);
+        }
+        if (real_out < 0)
+        {
+                pthread_mutex_unlock(&out_lock);
+                close(fd);
+                return -1;
+        }
+        captures++;
+        pthread_mutex_unlock(&out_lock);
+
+        return fd;
+}
+
+static void capture_stop(int fd)
+{
+        if (fd < 0)
+        {
+                return;
+        }
+
+        pthread_mutex_lock(&capture_lock);
+        if (installed == fd)
+        {
+                installed = -1;
+        }
+        close(fd);
+
+        pthread_mutex_lock(&out_lock);
+        if (--captures == 0)
+        {
+                // Restore stdout
+                dup2(real_out, 1);
+                close(real_out);
+                real_out = -1;
+                installed = -1;
+        }
+        pthread_mutex_unlock(&out_lock);
+        pthread_mutex_unlock(&capture_lock);
+}
+
+static void enter_test(void)
+{
+        if (!cur->worker)
+        {
+                pthread_mutex_lock(&capture_lock);
+                if (cur->fd >= 0 && installed != cur->fd)
+                {
+                        dup2(cur->fd, 1);
+                        installed = cur->fd;
+                }
+        }
+        pthread_sigmask(SIG_SETMASK, &cur->sigmask, NULL);
+        test_thread = pthread_self();
+        test_running = 1;
+        cur->in_test = 1;
+        test_run = cur;
+}
+
+static void leave_test(void)
+{
+        test_run = NULL;
+        cur->in_test = 0;
+        test_running = 0;
+        pthread_sigmask(SIG_SETMASK, &cur->idle_mask, NULL);
+        if (!cur->worker)
+        {
+                pthread_mutex_unlock(&capture_lock);
+        }
+}
+
+static void run_test(struct scut_test* test, 
+                     int fd, 
+                     struct scut_result* res, 
+                     char** captured)
+{
+        int timeout = get_timeout(test);
+        struct scut_usage before;
+        long long start;
+        int jmp;
+
+        memset(res, 0, sizeof(*res));
+        enter_test();
+        prepare_test();
+        if (cur->flags & SCUT_STATS)
+        {
+                usage_get(&before);
+        }
+        start = now_ns();
+        jmp = setjmp(cur->env);
+        if (jmp == 0)
+        {
+                watchdog(timeout);
+                if (test_setup(test))
+                {
+                        res->ret = 1;
+                }
+                else
+                {
+                        res->ret = run_body(test, res);
+                }
+                watchdog(0);
+        }
+        else
+        {
+                watchdog(0);
+                // Must restore signal mask
+                pthread_sigmask(SIG_SETMASK, &cur->sigmask, NULL);
+                if (cur->prop_pids)
+                {
+                        prop_stop();
+                }
+
+                res->ret = 1;
+        }
+        if (res->has_allocs)
+        {
+                /* Also drops assertions left by a longjmp */
+                alloc_resume(0);
+                res->allocs = alloc_stats;
+        }
+        if (res->has_perf)
+        {
+                perf_read(&res->perf);
+                for (int i = 0; i < PERF_EVENTS; ++i)
+                {
+                        if (res->perf.v[i] >= 0 && cur->perf_start.v[i] >= 0)
+                        {
+                                res->perf.v[i] -= cur->perf_start.v[i];
+                        }
+                        else
+                        {
+                                res->perf.v[i] = -1;
+                        }
+                }
+        }
+        if (cur->set_up && jmp != JMP_TIMEOUT)
+        {
+                /* Also after the test failed or crashed */
+                cur->set_up = 0;
+                if (setjmp(cur->env) == 0)
+                {
+                        watchdog(timeout);
+                        if (cur->suite->teardown())
+                        {
+                                res->ret = 1;
+                        }
+                        watchdog(0);
+                }
+                else
+                {
+                        watchdog(0);
+                        pthread_sigmask(SIG_SETMASK, &cur->sigmask, NULL);
+                        res->ret = 1;
+                }
+        }
+        cur->set_up = 0;
+        if (cur->has_stress)
+        {
+                res->has_stress = 1;
+                res->stress = cur->stress;
+        }
+        if (cur->num_failures)
+        {
+                res->ret = 1;
+                res->failures = cur->num_failures;
+                res->recorded = res->failures < MAX_FAILURES ? 
+                        res->failures : MAX_FAILURES;
+                res->fail = cur->failures;
+        }
+        res->ns = now_ns() - start;
+        if (cur->flags & SCUT_STATS)
+        {
+                usage_get(&res->usage);
+                usage_diff(&res->usage, &before);
+                res->has_usage = 1;
+        }
+        leave_test();
+        res->timed_out = jmp == JMP_TIMEOUT;
+        res->sig = res->timed_out ? 0 : jmp;
+        res->status = 0;
+
+        if (cur->samples)
+        {
+                baseline_check(test, res);
+        }
+
+        *captured = drain(fd);
+        res->len = *captured ? strlen(*captured) : 0;
+}
+
+/*
+ * Run the test itself, counting its allocations with SCUT_ALLOCS and
+ * its events with SCUT_PERF. The setup and teardown around it are not
+ * counted.
+ */
+static int run_body(struct scut_test* test, struct scut_result* res)
+{
+        if (cur->flags & SCUT_ALLOCS)
+        {
+                memset(&alloc_stats, 0, sizeof(alloc_stats));
+                res->has_allocs = 1;
+                alloc_track(1);
+        }
+        if (cur->flags & SCUT_PERF)
+        {
+                res->has_perf = 1;
+                perf_read(&cur->perf_start);
+        }
+        if (test->bench)
+        {
+                return run_bench(test, &res->bench);
+        }
+        if (test->prop)
+        {
+                return run_prop(test);
+        }
+        if (test->param)
+        {
+                return test->param((const char*)test->table + 
+                                   test->size * test->index);
+        }
+
+        return test->test();
+}
+
+/*
+ * Build the suite fixtures the test declared, then run the per test
+ * setup. The per test teardown is only due if the setup succeeded.
+ */
+static int test_setup(struct scut_test* test)
+{
+        for (int i = 0; i < test->num_fixtures; ++i)
+        {
+                if (fixture_get(test->fixtures[i], NULL))
+                {
+                        printf("Fixture %s failed to set up\n", 
+                               test->fixtures[i]->name);
+                        return 1;
+                }
+        }
+        if (cur->suite->setup && cur->suite->setup())
+        {
+                printf("Setup failed\n");
+                return 1;
+        }
+        cur->set_up = cur->suite->teardown != NULL;
+
+        return 0;
+}
+
+/*
+ * Get the data of a suite fixture, which is built the first time it is
+ * used in a run. Until its setup returns, also if it crashes, the
+ * fixture counts as failed, and it is never built again.
+ */
+static int fixture_get(const struct scut_fixture* fixture, void** data)
+{
+        struct scut_built* built;
+        void* d = NULL;
+        int i;
+
+        for (i = 0; i < cur->num_built; ++i)
+        {
+                if (cur->built[i].fixture == fixture)
+                {
+                        if (data)
+                        {
+                                *data = cur->built[i].data;
+                        }
+                        return cur->built[i].failed;
+                }
+        }
+
+        built = realloc(cur->built, sizeof(struct scut_built) * (i + 1));
+        if (built == NULL)
+        {
+                return 1;
+        }
+        cur->built = built;
+        cur->built[i].fixture = fixture;
+        cur->built[i].data = NULL;
+        cur->built[i].failed = 1;
+        cur->num_built++;
+        if (fixture->setup && fixture->setup(&d))
+        {
+                return 1;
+        }
+
+        /* The setup may have used other fixtures, and moved built */
+        cur->built[i].data = d;
+        cur->built[i].failed = 0;
+        if (data)
+        {
+                *data = d;
+        }
+
+        return 0;
+}
+
+/* Tear down the fixtures of the run, the last built first */
+static void fixtures_teardown(void)
+{
+        for (int i = cur->num_built - 1; i >= 0; --i)
+        {
+                const struct scut_fixture* f = cur->built[i].fixture;
+
+                if (!cur->built[i].failed && f->teardown)
+                {
+                        f->teardown(cur->built[i].data);
+                }
+        }
+        cur->num_built = 0;
+}
+
+/*
+ * The iteration count is first calibrated, which also warms up caches
+ * and branch predictors, so that one call takes about 1/BENCH_BATCHES of
+ * the time budget. The benchmark is then called repeatedly with that
+ * count, and the time per operation of each batch goes into a histogram.
+ */
+static int run_bench(struct scut_test* test, struct scut_bench_result* br)
+{
+        unsigned long long hist[HIST_SIZE];
+        struct scut_bench b;
+        long long budget = bench_time() * 1000000LL;
+        long long target = budget / BENCH_BATCHES;
+        unsigned long long n = 1;
+        unsigned long long total_n = 0;
+        unsigned long long max = 0;
+        long long total_ns = 0;
+        double mean = 0;
+        double m2 = 0;
+        long long start;
+        long long t;
+        int batches = 0;
+
+        for (;;)
+        {
+                b.n = n;
+                b.bytes = 0;
+                t = now_ns();
+                if (test->bench(&b))
+                {
+                        return 1;
+                }
+                t = now_ns() - t;
+                if (t >= target || n >= (1ULL << 40))
+                {
+                        break;
+                }
+
+                if (t < 1000)
+                {
+                        n *= 100;
+                }
+                else
+                {
+                        unsigned long long next = 
+                                (unsigned long long)(n * 1.2 * target / t);
+
+                        n = next < n * 2 ? n * 2 : 
+                                next > n * 100 ? n * 100 : next;
+                }
+        }
+
+        memset(hist, 0, sizeof(hist));
+        start = now_ns();
+        while (batches < BENCH_MAX_BATCHES && 
+               (batches < BENCH_BATCHES / 10 || now_ns() - start < budget))
+        {
+                unsigned long long ps;
+                double delta;
+                double x;
+
+                b.n = n;
+                t = now_ns();
+                if (test->bench(&b))
+                {
+                        return 1;
+                }
+                t = now_ns() - t;
+
+                ps = (unsigned long long)t * 1000 / n;
+                hist[hist_bucket(ps)]++;
+                if (ps > max)
+                {
+                        max = ps;
+                }
+                total_ns += t;
+                total_n += n;
+                batches++;
+                /* Welford's online variance of the time per iteration */
+                x = (double)t / n;
+                delta = x - mean;
+                mean += delta / batches;
+                m2 += delta * (x - mean);
+        }
+
+        br->ran = 1;
+        br->bytes = b.bytes;
+        br->ns_op = (double)total_ns / total_n;
+        br->p50 = hist_percentile(hist, batches, 0.50);
+        br->p90 = hist_percentile(hist, batches, 0.90);
+        br->p99 = hist_percentile(hist, batches, 0.99);
+        br->max = max / 1000.0;
+        br->var = batches > 1 ? m2 / (batches - 1) : 0;
+        br->batches = batches;
+
+        return 0;
+}
+
+static int bench_time(void)
+{
+        const char* env = getenv("SCUT_BENCH_TIME");
+        int ms = 0;
+
+        if (env)
+        {
+                ms = (int)strtol(env, NULL, 10);
+        }
+
+        return ms > 0 ? ms : BENCH_TIME;
+}
+
+static int hist_bucket(unsigned long long v)
+{
+        int e = 0;
+
+        if (v < HIST_SUB)
+        {
+                return (int)v;
+        }
+        while (v >> (e + 1))
+        {
+                e++;
+        }
+
+        return (e - HIST_SUB_BITS + 1) * HIST_SUB + 
+                (int)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* Midpoint of a bucket, picoseconds are converted back to ns */
+static double hist_value(int i)
+{
+        int e;
+        unsigned long long low;
+        unsigned long long width;
+
+        if (i < HIST_SUB)
+        {
+                return i / 1000.0;
+        }
+        e = i / HIST_SUB + HIST_SUB_BITS - 1;
+        width = 1ULL << (e - HIST_SUB_BITS);
+        low = (unsigned long long)(HIST_SUB + i % HIST_SUB) * width;
+
+        return (low + width / 2.0) / 1000.0;
+}
+
+static double hist_percentile(const unsigned long long* hist, 
+                              unsigned long long count, 
+                              double p)
+{
+        unsigned long long rank = (unsigned long long)(p * count);
+        unsigned long long seen = 0;
+
+        for (int i = 0; i < HIST_SIZE; ++i)
+        {
+                seen += hist[i];
+                if (seen > rank)
+                {
+                        return hist_value(i);
+                }
+        }
+
+        return 0;
+}
+
+/*
+ * Search for a failing case, starting from SCUT_SEED if set, and shrink
+ * it. Large searches are spread over forked processes, each trying every
+ * jobs:th case. The failing case is then run again here, where its
+ * choices are recorded, so the result does not depend on which process
+ * found it.
+ */
+static int run_prop(struct scut_test* test)
+{
+        struct scut_prop p;
+        const char* env = getenv("SCUT_SEED");
+        unsigned long long seed;
+        long long cases = test->prop_cases;
+        long long ms = test->prop_ms;
+        long long deadline = 0;
+        long long ran = 0;
+        long long found;
+        int jobs = 1;
+        int shrinks;
+
+        if (cases <= 0 && ms <= 0)
+        {
+                cases = env_int("SCUT_PROP_CASES");
+                ms = env_int("SCUT_PROP_TIME");
+                if (cases <= 0 && ms <= 0)
+                {
+                        cases = PROP_CASES;
+                }
+        }
+        if (ms > 0)
+        {
+                deadline = now_ns() + ms * 1000000LL;
+        }
+        if (env && *env)
+        {
+                seed = strtoull(env, NULL, 10);
+        }
+        else
+        {
+                seed = (unsigned long long)now_ns() ^ 
+                        (unsigned long long)getpid() << 32;
+                seed = splitmix(&seed);
+                if (!cur->worker && (ms > 0 || cases >= PROP_FORK_CASES))
+                {
+                        jobs = env_int("SCUT_PROP_JOBS");
+                        if (jobs < 1)
+                        {
+                                jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+                        }
+                }
+        }
+
+        memset(&p, 0, sizeof(p));
+        p.prop = test->prop;
+        if (jobs > 1)
+        {
+                found = prop_fork(&p, seed, jobs, cases, deadline, &ran);
+        }
+        else
+        {
+                found = prop_search(&p, seed, 0, 1, cases, deadline, &ran);
+        }
+        if (found < 0)
+        {
+                free(p.tape);
+                if (found < -1)
+                {
+                        printf("Property search process died, seed %llu\n", 
+                               seed);
+                        return 1;
+                }
+                printf("%lld cases passed, seed %llu\n", ran, seed);
+                return 0;
+        }
+
+        seed += (unsigned long long)found * PROP_GAMMA;
+        prop_seed(&p, seed);
+        if (prop_case(&p) == 0)
+        {
+                free(p.tape);
+                printf("Property failed in a search process, but not when "
+                       "run again, SCUT_SEED=%llu\n", 
+                       seed);
+                return 1;
+        }
+        shrinks = prop_shrink(&p);
+
+        /* Once more, to leave the output of the smallest counterexample */
+        p.replay = 1;
+        prop_case(&p);
+        if (p.sig)
+        {
+                printf("Caught signal %d\n", p.sig);
+        }
+        printf("Falsified after %lld cases, shrunk %d times, "
+               "reproduce with SCUT_SEED=%llu\n",
+               ran,
+               shrinks,
+               seed);
+        free(p.tape);
+        free(p.spare);
+
+        return 1;
+}
+
+/*
+ * Run one case, from the PRNG or by replaying the tape. A signal fails
+ * the case rather than the test, only a timeout ends the search. Only
+ * the output of the last case is kept in the capture file.
+ */
+static int prop_case(struct scut_prop* p)
+{
+        jmp_buf env;
+        int ret;
+        int jmp;
+
+        if (cur->fd >= 0 || cur->worker)
+        {
+                fflush(stdout);
+                if (lseek(1, 0, SEEK_CUR) > 0 && ftruncate(1, 0) == 0)
+                {
+                        lseek(1, 0, SEEK_SET);
+                }
+        }
+        p->pos = 0;
+        if (!p->replay)
+        {
+                p->len = 0;
+        }
+
+        memcpy(env, cur->env, sizeof(jmp_buf));
+        jmp = setjmp(cur->env);
+        if (jmp == 0)
+        {
+                ret = p->prop(p) != 0;
+        }
+        else
+        {
+                pthread_sigmask(SIG_SETMASK, &cur->sigmask, NULL);
+                ret = 1;
+        }
+        memcpy(cur->env, env, sizeof(jmp_buf));
+        if (jmp == JMP_TIMEOUT)
+        {
+                longjmp(cur->env, JMP_TIMEOUT);
+        }
+        p->sig = jmp;
+
+        return ret;
+}
+
+/* Try cases first, first + step, ... and return the first that fails */
+static long long prop_search(struct scut_prop* p, 
+                             unsigned long long seed, 
+                             long long first, 
+                             int step, 
+                             long long cases, 
+                             long long deadline,
+                             long long* ran)
+{
+        for (long long k = first; cases <= 0 || k < cases; k += step)
+        {
+                if (deadline && now_ns() >= deadline)
+                {
+                        break;
+                }
+                prop_seed(p, seed + (unsigned long long)k * PROP_GAMMA);
+                (*ran)++;
+                if (prop_case(p))
+                {
+                        return k;
+                }
+        }
+
+        return -1;
+}
+
+/*
+ * Each process reports the first case it found failing, if any, and how
+ * many it ran. The others are stopped at the first failure. Returns the
+ * failing case, -1 if none was found, and -2 if a process died. The
+ * processes are kept in cur, so a timeout or crash can stop them.
+ */
+static long long prop_fork(struct scut_prop* p, 
+                           unsigned long long seed, 
+                           int jobs, 
+                           long long cases, 
+                           long long deadline,
+                           long long* ran)
+{
+        pid_t* pids = malloc(sizeof(pid_t) * jobs);
+        long long found = -1;
+        long long msg[2];
+        int reported = 0;
+        int caught;
+        int fds[2];
+        int n;
+
+        if (pids == NULL || pipe(fds))
+        {
+                free(pids);
+                return prop_search(p, seed, 0, 1, cases, deadline, ran);
+        }
+
+        /* The processes exiting is no failure */
+        caught = sigismember(&cur->sig_expected, SIGCHLD) == 1;
+        sigaddset(&cur->sig_expected, SIGCHLD);
+        fflush(stdout);
+        cur->prop_pids = pids;
+        cur->prop_jobs = 0;
+        cur->prop_fd = fds[0];
+        for (; cur->prop_jobs < jobs; ++cur->prop_jobs)
+        {
+                n = cur->prop_jobs;
+                pids[n] = fork();
+                if (pids[n] < 0)
+                {
+                        break;
+                }
+                if (pids[n] == 0)
+                {
+                        int null = open("/dev/null", O_WRONLY);
+
+                        close(fds[0]);
+                        if (null >= 0)
+                        {
+                                dup2(null, 1);
+                        }
+                        msg[1] = 0;
+                        msg[0] = prop_search(p, 
+                                             seed, 
+                                             n, 
+                                             jobs, 
+                                             cases, 
+                                             deadline, 
+                                             msg + 1);
+                        _exit(write_all(fds[1], msg, sizeof(msg)));
+                }
+        }
+        n = cur->prop_jobs;
+        close(fds[1]);
+
+        /* Messages are shorter than PIPE_BUF, so they are never mixed */
+        while (read_all(fds[0], msg, sizeof(msg)) == 0)
+        {
+                reported++;
+                *ran += msg[1];
+                if (msg[0] >= 0 && (found < 0 || msg[0] < found))
+                {
+                        found = msg[0];
+                        for (int i = 0; i < n; ++i)
+                        {
+                                kill(pids[i], SIGKILL);
+                        }
+                }
+        }
+        prop_stop();
+        if (!caught)
+        {
+                sigdelset(&cur->sig_expected, SIGCHLD);
+                sigdelset(&cur->sig_caught, SIGCHLD);
+        }
+        if (n == 0)
+        {
+                return prop_search(p, seed, 0, 1, cases, deadline, ran);
+        }
+
+        return found < 0 && reported < n ? -2 : found;
+}
+
+/* Kill and reap the processes of a property search */
+static void prop_stop(void)
+{
+        close(cur->prop_fd);
+        for (int i = 0; i < cur->prop_jobs; ++i)
+        {
+                kill(cur->prop_pids[i], SIGKILL);
+                while (waitpid(cur->prop_pids[i], NULL, 0) < 0 && 
+                       errno == EINTR)
+                {
+                }
+        }
+        free(cur->prop_pids);
+        cur->prop_pids = NULL;
+        cur->prop_jobs = 0;
+}
+
+/*
+ * Make the failing tape simpler until no edit helps: remove runs of
+ * choices, zero them, then make single choices smaller by bisection.
+ * Returns the number of edits kept.
+ */
+static int prop_shrink(struct scut_prop* p)
+{
+        int budget = PROP_SHRINKS;
+        int shrinks = 0;
+        int progress = 1;
+
+        p->spare = malloc(sizeof(unsigned long long) * (p->len ? p->len : 1));
+        if (p->spare == NULL)
+        {
+                return 0;
+        }
+
+        while (progress && budget > 0)
+        {
+                progress = 0;
+                for (int size = 8; size > 0; size /= 2)
+                {
+                        for (int i = p->len - size; i >= 0; --i)
+                        {
+                                /* The tape may have become shorter */
+                                if (i > p->len - size)
+                                {
+                                        i = p->len - size;
+                                        if (i < 0)
+                                        {
+                                                break;
+                                        }
+                                }
+                                memcpy(p->spare, p->tape, sizeof(*p->tape) * i);
+                                memcpy(p->spare + i, 
+                                       p->tape + i + size, 
+                                       sizeof(*p->tape) * (p->len - i - size));
+                                if (prop_try(p, p->len - size, &budget))
+                                {
+                                        shrinks++;
+                                        progress = 1;
+                                }
+                        }
+                }
+                for (int size = 8; size > 1; size /= 2)
+                {
+                        for (int i = 0; i + size <= p->len; ++i)
+                        {
+                                int zero = 1;
+
+                                for (int j = i; j < i + size; ++j)
+                                {
+                                        zero = zero && p->tape[j] == 0;
+                                }
+                                if (zero)
+                                {
+                                        continue;
+                                }
+                                memcpy(p->spare, 
+                                       p->tape, 
+                                       sizeof(*p->tape) * p->len);
+                                memset(p->spare + i, 
+                                       0, 
+                                       sizeof(*p->tape) * size);
+                                if (prop_try(p, p->len, &budget))
+                                {
+                                        shrinks++;
+                                        progress = 1;
+                                }
+                        }
+                }
+                for (int i = 0; i < p->len; ++i)
+                {
+                        unsigned long long lo = 0;
+                        unsigned long long hi = p->tape[i];
+
+                        while (lo < hi && i < p->len)
+                        {
+                                unsigned long long mid = lo + (hi - lo) / 2;
+
+                                memcpy(p->spare, 
+                                       p->tape, 
+                                       sizeof(*p->tape) * p->len);
+                                p->spare[i] = mid;
+                                if (prop_try(p, p->len, &budget))
+                                {
+                                        hi = mid;
+                                        shrinks++;
+                                        progress = 1;
+                                }
+                                else if (budget > 0)
+                                {
+                                        lo = mid + 1;
+                                }
+                                else
+                                {
+                                        break;
+                                }
+                        }
+
+                        /* Choices alternate signs, try 2 smaller */
+                        if (i < p->len && p->tape[i] >= 2)
+                        {
+                                memcpy(p->spare, 
+                                       p->tape, 
+                                       sizeof(*p->tape) * p->len);
+                                p->spare[i] -= 2;
+                                if (prop_try(p, p->len, &budget))
+                                {
+                                        shrinks++;
+                                        progress = 1;
+                                }
+                        }
+                }
+        }
+
+        return shrinks;
+}
+
+/* Replay the spare tape, and keep it if it still fails */
+static int prop_try(struct scut_prop* p, int len, int* budget)
+{
+        unsigned long long* tape = p->tape;
+        int old = p->len;
+
+        if (*budget <= 0)
+        {
+                return 0;
+        }
+        (*budget)--;
+
+        p->tape = p->spare;
+        p->len = len;
+        p->replay = 1;
+        if (prop_case(p))
+        {
+                /* Choices the case did not use are dropped */
+                if (p->pos < p->len)
+                {
+                        p->len = p->pos;
+                }
+                p->spare = tape;
+                return 1;
+        }
+        p->tape = tape;
+        p->len = old;
+
+        return 0;
+}
+
+static void prop_seed(struct scut_prop* p, unsigned long long seed)
+{
+        for (int i = 0; i < 4; ++i)
+        {
+                p->s[i] = splitmix(&seed);
+        }
+        p->replay = 0;
+}
+
+static unsigned long long prop_draw(struct scut_prop* p)
+{
+        unsigned long long* s = p->s;
+        unsigned long long r;
+        unsigned long long t;
+
+        if (p->replay)
+        {
+                return p->pos < p->len ? p->tape[p->pos++] : (p->pos++, 0);
+        }
+
+        /* xoshiro256** */
+        r = s[1] * 5;
+        r = ((r << 7) | (r >> 57)) * 9;
+        t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = (s[3] << 45) | (s[3] >> 19);
+
+        if (p->len == p->cap && p->cap < PROP_TAPE)
+        {
+                int cap = p->cap ? p->cap * 2 : 256;
+                unsigned long long* tape = 
+                        realloc(p->tape, sizeof(unsigned long long) * cap);
+
+                if (tape)
+                {
+                        p->tape = tape;
+                        p->cap = cap;
+                }
+        }
+        if (p->len < p->cap)
+        {
+                p->tape[p->len++] = r;
+        }
+
+        return r;
+}
+
+static unsigned long long splitmix(unsigned long long* x)
+{
+        unsigned long long z = (*x += PROP_GAMMA);
+
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+        return z ^ (z >> 31);
+}
+
+long long scut_gen_int(struct scut_prop* p, long long min, long long max)
+{
+        unsigned long long span = (unsigned long long)max - 
+                (unsigned long long)min;
+        unsigned long long u = prop_draw(p);
+        long long v;
+
+        if (max <= min)
+        {
+                return min;
+        }
+        if (span != ~0ULL)
+        {
+                u %= span + 1;
+        }
+
+        /* Shrinks towards 0: 0, 1, -1, 2, -2, ... or from the bound nearest */
+        if (min >= 0)
+        {
+                return (long long)((unsigned long long)min + u);
+        }
+        if (max <= 0)
+        {
+                return (long long)((unsigned long long)max - u);
+        }
+        v = u & 1 ? (long long)(u / 2 + 1) : -(long long)(u / 2);
+        if (v < min || v > max)
+        {
+                v = (long long)((unsigned long long)min + u);
+        }
+
+        return v;
+}
+
+double scut_gen_double(struct scut_prop* p, double min, double max)
+{
+        unsigned long long u = prop_draw(p);
+        double origin = min > 0 ? min : (max < 0 ? max : 0);
+        double f = (double)(u >> 11) / 9007199254740992.0;
+
+        if (!(max > min))
+        {
+                return min;
+        }
+
+        /* The low bit picks the side of the origin, the rest the distance */
+        return u & 1 ? origin + f * (max - origin) : origin - f * (origin - min);
+}
+
+size_t scut_gen_bytes(struct scut_prop* p, void* buf, size_t max)
+{
+        unsigned char* b = buf;
+        size_t n = (size_t)scut_gen_int(p, 0, (long long)max);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+                b[i] = (unsigned char)prop_draw(p);
+        }
+
+        return n;
+}
+
+size_t scut_gen_string(struct scut_prop* p, char* buf, size_t size)
+{
+        size_t n;
+
+        if (size == 0)
+        {
+                return 0;
+        }
+        n = (size_t)scut_gen_int(p, 0, (long long)size - 1);
+
+        /* Printable ASCII, shrinking towards 'a' */
+        for (size_t i = 0; i < n; ++i)
+        {
+                buf[i] = (char)(' ' + (prop_draw(p) + 'a' - ' ') % 95);
+        }
+        buf[n] = 0;
+
+        return n;
+}
+
+static int run_serial(int fd)
+{
+        struct scut_result res;
+        int failed = 0;
+
+        /* Once per run, a test that replaces a handler breaks the rest */
+        sig_setup();
+
+        for (int i = 0; i < cur->count; ++i)
+        {
+                char* captured;
+
+                if (cur->cached && cur->cached[i])
+                {
+                        /* Also after fail fast stopped, as in run_parallel */
+                        report_start(test_at(i));
+                        memset(&res, 0, sizeof(res));
+                        res.cached = 1;
+                        report_end(test_at(i), &res, NULL);
+                        continue;
+                }
+                if (cur->fail_fast > 0 && failed >= cur->fail_fast)
+                {
+                        report_skip(test_at(i));
+                        continue;
+                }
+                report_start(test_at(i));
+                run_test(test_at(i), fd, &res, &captured);
+                report_end(test_at(i), &res, captured);
+                if (res.ret)
+                {
+                        failed++;
+                }
+                free(captured);
+        }
+
+        return failed;
+}
+
+/* Position of the next test to hand to a worker, -1 if there is none */
+static int next_test(int* next)
+{
+        while (*next < cur->count && 
+               cur->cached && cur->cached[cur->dispatch[*next]])
+        {
+                (*next)++;
+        }
+
+        return *next < cur->count ? cur->dispatch[(*next)++] : -1;
+}
+
+/*
+ * Tests are handed out one at a time to a pool of forked workers, so a
+ * slow test never holds up a queue of others. Results are collected as
+ * they arrive, but printed strictly in suite order. A worker that dies
+ * only fails the test it was running, and is replaced by a fresh one.
+ * With isolation the same happens after a worker ran its batch of
+ * tests, or any test that failed, which may have left it dirty.
+ */
+static int run_parallel(int jobs)
+{
+        struct scut_worker* workers;
+        struct scut_result* results;
+        struct pollfd* pfds;
+        char empty = 0;
+        struct timespec zero = {0, 0};
+        sigset_t pipe_set;
+        sigset_t old_mask;
+        char** captured;
+        char* done;
+        int next = 0;
+        int printed = 0;
+        int failed = 0;
+        int arrived = 0;
+        int running = 0;
+
+        if (jobs > cur->count - cur->num_cached)
+        {
+                jobs = cur->count - cur->num_cached;
+        }
+
+        workers = calloc(jobs, sizeof(struct scut_worker));
+        pfds = calloc(jobs, sizeof(struct pollfd));
+        results = calloc(cur->count, sizeof(struct scut_result));
+        captured = calloc(cur->count, sizeof(char*));
+        done = calloc(cur->count, 1);
+        if (!workers || !pfds || !results || !captured || !done)
+        {
+                free(workers);
+                free(pfds);
+                free(results);
+                free(captured);
+                free(done);
+                return run_serial(-1);
+        }
+
+        /* 
+         * The parent must see dead workers as EOF on their pipes, not as
+         * signals routed to sig_trap. Signal dispositions are shared with
+         * runs in other threads, so SIGPIPE is only blocked in this
+         * thread, and sig_trap ignores SIGCHLD while parallel_runs is set.
+         */
+        sigemptyset(&pipe_set);
+        sigaddset(&pipe_set, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe_set, &old_mask);
+        parallel_runs++;
+
+        for (int i = 0; cur->cached && i < cur->count; ++i)
+        {
+                results[i].cached = cur->cached[i];
+                done[i] = cur->cached[i];
+        }
+
+        /* Fixtures built before the fork are shared copy-on-write */
+        for (int i = 0; i < cur->count; ++i)
+        {
+                struct scut_test* t = test_at(i);
+
+                for (int j = 0; !done[i] && j < t->num_fixtures; ++j)
+                {
+                        fixture_get(t->fixtures[j], NULL);
+                }
+        }
+
+        for (int i = 0; i < jobs; ++i)
+        {
+                workers[i].test = -1;
+                if (spawn_worker(workers, jobs, i) == 0)
+                {
+                        workers[i].test = next_test(&next);
+                        workers[i].start = now_ns();
+                        write_all(workers[i].cmd, 
+                                  &workers[i].test, 
+                                  sizeof(int));
+                        running++;
+                }
+        }
+
+        while (running)
+        {
+                long long now = now_ns();
+                int wait = -1;
+                int n = 0;
+
+                for (int i = 0; i < jobs; ++i)
+                {
+                        struct scut_worker* w = workers + i;
+
+                        pfds[i].fd = w->test < 0 ? -1 : w->res;
+                        pfds[i].events = POLLIN;
+                        pfds[i].revents = 0;
+
+                        if (w->test >= 0 && !w->killed)
+                        {
+                                int timeout = get_timeout(test_at(w->test));
+                                long long left;
+
+                                if (timeout < 1)
+                                {
+                                        continue;
+                                }
+                                left = w->start + 
+                                        (timeout + KILL_GRACE_MS) * 1000000LL - 
+                                        now;
+                                if (left <= 0)
+                                {
+                                        /* Hung with the watchdog blocked */
+                                        kill(w->pid, SIGKILL);
+                                        w->killed = 1;
+                                        continue;
+                                }
+                                if (wait < 0 || left / 1000000 + 1 < wait)
+                                {
+                                        wait = (int)(left / 1000000) + 1;
+                                }
+                        }
+                }
+                if (poll(pfds, jobs, wait) < 0)
+                {
+                        if (errno == EINTR)
+                        {
+                                continue;
+                        }
+                        break;
+                }
+
+                for (int i = 0; i < jobs; ++i)
+                {
+                        struct scut_worker* w = workers + i;
+                        struct scut_result* r;
+                        int t = w->test;
+
+                        if (t < 0 || pfds[i].revents == 0)
+                        {
+                                continue;
+                        }
+                        r = results + t;
+                        captured[t] = &empty;
+                        if (read_all(w->res, r, sizeof(*r)) == 0)
+                        {
+                                captured[t] = r->len ? malloc(r->len + 1) : NULL;
+                                if (captured[t] && 
+                                    read_all(w->res, captured[t], r->len) == 0)
+                                {
+                                        captured[t][r->len] = 0;
+                                }
+                                else if (r->len)
+                                {
+                                        free(captured[t]);
+                                        captured[t] = &empty;
+                                }
+                                r->fail = NULL;
+                                if (captured[t] != &empty && r->recorded &&
+                                    ((r->fail = malloc(sizeof(*r->fail) * r->recorded)) == NULL ||
+                                     read_all(w->res, r->fail, sizeof(*r->fail) * r->recorded)))
+                                {
+                                        free(r->fail);
+                                        free(captured[t]);
+                                        captured[t] = &empty;
+                                }
+                        }
+
+                        if (captured[t] == &empty)
+                        {
+                                /* Worker died, fail the test it was running */
+                                int status = stop_worker(w);
+
+                                r->ret = 1;
+                                r->sig = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+                                r->status = WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+                                r->timed_out = w->killed;
+                                r->ns = now_ns() - w->start;
+                                r->len = 0;
+                                r->failures = 0;
+                                r->recorded = 0;
+                                r->fail = NULL;
+                                if (w->killed)
+                                {
+                                        r->sig = 0;
+                                }
+                                captured[t] = NULL;
+                                w->pid = 0;
+                        }
+                        else if (cur->isolate && 
+                                 (++w->ran >= cur->isolate || r->ret))
+                        {
+                                /* Done with its batch, or possibly dirty */
+                                stop_worker(w);
+                                w->pid = 0;
+                        }
+                        if (w->pid == 0)
+                        {
+                                /* Replaced by a clean fork of this process */
+                                w->test = -1;
+                                running--;
+                                if (next < cur->count && 
+                                    spawn_worker(workers, jobs, i) == 0)
+                                {
+                                        running++;
+                                }
+                                else
+                                {
+                                        w->pid = -1;
+                                }
+                        }
+                        done[t] = 1;
+                        n++;
+                        if (r->ret && cur->fail_fast > 0 && 
+                            ++arrived >= cur->fail_fast)
+                        {
+                                /* Let running tests finish, start no more */
+                                next = cur->count;
+                        }
+
+                        if (w->pid > 0)
+                        {
+                                w->test = next_test(&next);
+                                w->start = now_ns();
+                                write_all(w->cmd, &w->test, sizeof(int));
+                                if (w->test < 0)
+                                {
+                                        running--;
+                                }
+                        }
+                }
+
+                while (printed < cur->count && done[printed])
+                {
+                        report_start(test_at(printed));
+                        report_end(test_at(printed), 
+                                   results + printed, 
+                                   captured[printed]);
+                        if (results[printed].ret)
+                        {
+                                failed++;
+                        }
+                        free(captured[printed]);
+                        free(results[printed].fail);
+                        captured[printed] = NULL;
+                        printed++;
+                }
+
+                if (n == 0 && running == 0)
+                {
+                        break;
+                }
+        }
+
+        for (int i = 0; i < jobs; ++i)
+        {
+                if (workers[i].pid > 0)
+                {
+                        close(workers[i].cmd);
+                        close(workers[i].res);
+                        /* Another worker exiting may interrupt the wait */
+                        while (waitpid(workers[i].pid, NULL, 0) < 0 && 
+                               errno == EINTR)
+                        {
+                        }
+                }
+        }
+
+        /* Anything never run is skipped by fail fast, or fork failed */
+        while (printed < cur->count)
+        {
+                if (!done[printed] && cur->fail_fast > 0 && 
+                    arrived >= cur->fail_fast)
+                {
+                        report_skip(test_at(printed++));
+                        continue;
+                }
+                report_start(test_at(printed));
+                if (!done[printed])
+                {
+                        results[printed].ret = 1;
+                }
+                report_end(test_at(printed), 
+                           results + printed, 
+                           captured[printed]);
+                if (results[printed].ret)
+                {
+                        failed++;
+                }
+                free(captured[printed]);
+                free(results[printed].fail);
+                printed++;
+        }
+
+        parallel_runs--;
+        while (sigtimedwait(&pipe_set, NULL, &zero) > 0)
+        {
+        }
+        pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+        free(workers);
+        free(pfds);
+        free(results);
+        free(captured);
+        free(done);
+
+        return failed;
+}
+
+static void report_start(struct scut_test* test)
+{
+        cur->reporter->test_start(test);
+}
+
+static void report_skip(struct scut_test* test)
+{
+        cur->skipped++;
+        if (cur->reporter->test_skip)
+        {
+                cur->reporter->test_skip(test);
+        }
+}
+
+static void report_end(struct scut_test* test, 
+                       struct scut_result* res, 
+                       const char* captured)
+{
+        if (cur->samples && !res->cached)
+        {
+                cur->samples[test->unit] = res->sample;
+        }
+        if (cur->took && !res->cached)
+        {
+                cur->took[test->unit].ns = res->ns;
+                cur->took[test->unit].failed = res->ret != 0;
+        }
+        if (cur->slowest_cap > 0)
+        {
+                /* Keep the slowest tests sorted, slowest first */
+                int i = cur->slowest_len;
+
+                if (i < cur->slowest_cap)
+                {
+                        cur->slowest_len++;
+                }
+                else if (res->ns > cur->slowest[i - 1].ns)
+                {
+                        i--;
+                }
+                else
+                {
+                        i = -1;
+                }
+                for (; i > 0 && cur->slowest[i - 1].ns < res->ns; --i)
+                {
+                        cur->slowest[i] = cur->slowest[i - 1];
+                }
+                if (i >= 0)
+                {
+                        cur->slowest[i].ns = res->ns;
+                        snprintf(cur->slowest[i].name, 
+                                 MAX_MSG, 
+                                 "%s", 
+                                 test->name);
+                }
+        }
+
+        cur->reporter->test_end(test, res, captured);
+}
+
+static const struct scut_reporter* get_reporter(int flags)
+{
+        static const struct scut_reporter human = {
+                &human_suite_start,
+                &human_test_start,
+                &human_test_end,
+                &human_suite_end,
+                NULL
+        };
+        static const struct scut_reporter tap = {
+                &tap_suite_start,
+                &tap_test_start,
+                &tap_test_end,
+                &tap_suite_end,
+                NULL
+        };
+        static const struct scut_reporter junit = {
+                &junit_suite_start,
+                &tap_test_start,
+                &junit_test_end,
+                &junit_suite_end,
+                &junit_test_skip
+        };
+        static const struct scut_reporter jsonl = {
+                &jsonl_suite_start,
+                &jsonl_test_start,
+                &jsonl_test_end,
+                &jsonl_suite_end,
+                NULL
+        };
+        const char* env = getenv("SCUT_REPORTER");
+
+        if (flags & SCUT_TAP)
+        {
+                return &tap;
+        }
+        if (flags & SCUT_JUNIT)
+        {
+                return &junit;
+        }
+        if (flags & SCUT_JSONL)
+        {
+                return &jsonl;
+        }
+        if (env && strcmp(env, "tap") == 0)
+        {
+                return &tap;
+        }
+        if (env && strcmp(env, "junit") == 0)
+        {
+                return &junit;
+        }
+        if (env && strcmp(env, "jsonl") == 0)
+        {
+                return &jsonl;
+        }
+
+        return &human;
+}
+
+static const char* result_name(struct scut_result* res)
+{
+        if (res->cached)
+        {
+                return "cached";
+        }
+        if (res->timed_out)
+        {
+                return "timed out";
+        }
+        if (res->ret)
+        {
+                return "failed";
+        }
+
+        return "ok";
+}
+
+/* Why a test failed, beyond its own output. Returns 0 if nothing to add */
+static int result_msg(struct scut_result* res, char* buf, size_t len)
+{
+        if (res->timed_out)
+        {
+                return snprintf(buf, len, "Timed out after %.3f s", res->ns / 1e9);
+        }
+        if (res->ret && res->sig)
+        {
+                return snprintf(buf, len, "Killed by signal %d", res->sig);
+        }
+        if (res->ret && res->status)
+        {
+                return snprintf(buf, len, "Exited with status %d", res->status);
+        }
+        if (res->regressed)
+        {
+                return snprintf(buf, 
+                                len, 
+                                "Slower than the baseline by more than %g%%",
+                                res->tolerance * 100);
+        }
+        if (res->failures)
+        {
+                return snprintf(buf, 
+                                len, 
+                                "%d expectation%s failed", 
+                                res->failures, 
+                                res->failures == 1 ? "" : "s");
+        }
+
+        return 0;
+}
+
+static void human_suite_start(void)
+{
+        char buf[MAX_MSG];
+
+        snprintf(buf, MAX_MSG, "> Running suite %s%s%s\n", BOLD, 
+                 cur->suite->name, 
+                 BOLDOFF);
+        say(buf);
+}
+
+static void human_test_start(struct scut_test* test)
+{
+        char buf[MAX_MSG];
+
+        snprintf(buf, MAX_MSG, "Running %16s: ", test->name);
+        say(buf);
+}
+
+static void human_test_end(struct scut_test* test, 
+                           struct scut_result* res, 
+                           const char* captured)
+{
+        char buf[MAX_MSG];
+        char msg[MAX_MSG];
+
+        (void)test;
+        if (res->cached)
+        {
+                snprintf(buf, MAX_MSG, BOLD "CACHED" BOLDOFF "\n");
+                say(buf);
+        }
+        else if (res->timed_out)
+        {
+                snprintf(buf, MAX_MSG, BOLD "TIMED OUT" BOLDOFF "\n");
+                say(buf);
+        }
+        else if (res->ret)
+        {
+                snprintf(buf, MAX_MSG, BOLD "FAILED" BOLDOFF "\n");
+                say(buf);
+        }
+        else
+        {
+                snprintf(buf, MAX_MSG, BOLD "Ok" BOLDOFF "\n");
+                say(buf);
+        }
+
+        if (result_msg(res, msg, MAX_MSG))
+        {
+                say("> ");
+                say(msg);
+                say("\n");
+        }
+
+        if (res->failures)
+        {
+                human_failures(res);
+        }
+
+        if (res->has_usage)
+        {
+                snprintf(buf, MAX_MSG, "> %.3f ms wall, ", res->ns / 1e6);
+                say(buf);
+                human_usage(&res->usage);
+        }
+
+        if (res->has_allocs)
+        {
+                human_allocs(&res->allocs);
+        }
+
+        if (res->has_perf)
+        {
+                human_perf(&res->perf);
+        }
+
+        if (res->has_baseline)
+        {
+                human_baseline(res);
+        }
+
+        if (res->has_stress)
+        {
+                human_stress(&res->stress);
+        }
+
+        if (res->bench.ran)
+        {
+                struct scut_bench_result* b = &res->bench;
+                int n;
+
+                n = snprintf(buf, 
+                             MAX_MSG, 
+                             "> %.2f ns/op, %.0f op/s", 
+                             b->ns_op, 
+                             1e9 / b->ns_op);
+                if (b->bytes)
+                {
+                        n += snprintf(buf + n, 
+                                      MAX_MSG - n, 
+                                      ", %.2f MB/s", 
+                                      b->bytes * 1e3 / b->ns_op);
+                }
+                snprintf(buf + n, 
+                         MAX_MSG - n, 
+                         ", p50 %.2f, p90 %.2f, p99 %.2f, max %.2f ns\n",
+                         b->p50, 
+                         b->p90, 
+                         b->p99, 
+                         b->max);
+                say(buf);
+        }
+
+        if ((res->ret || (cur->flags & SCUT_VERBOSE)) && captured && *captured)
+        {
+                snprintf(buf, MAX_MSG, ">>> Captured output <<<\n\n");
+                say(buf);
+                say(captured);
+                snprintf(buf, MAX_MSG, "\n>>> End of output <<<\n");
+                say(buf);
+        }
+}
+
+static void human_suite_end(int count, int failed)
+{
+        char buf[MAX_MSG];
+
+        if (cur->slowest_cap > 0)
+        {
+                human_slowest();
+        }
+
+        snprintf(buf, MAX_MSG, "\nResult: %d performed\n", count - cur->num_cached);
+        say(buf);
+        if (cur->num_cached)
+        {
+                snprintf(buf, 
+                         MAX_MSG, 
+                         "Result: %d cached, passed before and not run\n", 
+                         cur->num_cached);
+                say(buf);
+        }
+        if (cur->skipped)
+        {
+                snprintf(buf, 
+                         MAX_MSG, 
+                         "Result: %d skipped, stopped after %d failed tests\n", 
+                         cur->skipped, 
+                         failed);
+                say(buf);
+        }
+        if (failed)
+        {
+                snprintf(buf, MAX_MSG, "Result: %d failed tests\n", failed);
+                say(buf);
+
+                snprintf(buf, MAX_MSG, "Suite %s%s FAILED%s\n", 
+                         BOLD,
+                         cur->suite->name,
+                         BOLDOFF);
+                say(buf);
+        }
+        else 
+        {
+                snprintf(buf, MAX_MSG, "Suite %s%s SUCCESS%s\n",
+                         BOLD,
+                         cur->suite->name,
+                         BOLDOFF);
+                say(buf);
+        }
+}
+
+static void human_usage(const struct scut_usage* u)
+{
+        char buf[MAX_MSG];
+
+        snprintf(buf, 
+                 MAX_MSG,
+                 "%.3f ms user, %.3f ms sys, %+ld KiB max rss, "
+                 "%ld/%ld faults, %ld/%ld csw, %lld/%lld B io\n",
+                 u->utime / 1e6,
+                 u->stime / 1e6,
+                 u->maxrss,
+                 u->minflt,
+                 u->majflt,
+                 u->nvcsw,
+                 u->nivcsw,
+                 u->rbytes,
+                 u->wbytes);
+        say(buf);
+}
+
+static void human_allocs(const struct scut_allocs* a)
+{
+        char buf[MAX_MSG];
+        long long blocks;
+        long long bytes;
+
+        alloc_leaked(a, &blocks, &bytes);
+        snprintf(buf, 
+                 MAX_MSG,
+                 "> %lld allocs, %lld B allocated, %lld B peak, "
+                 "%lld B leaked in %lld blocks\n",
+                 a->allocs,
+                 a->bytes,
+                 a->peak,
+                 bytes,
+                 blocks);
+        say(buf);
+}
+
+/* Available counters first, followed by the names of the others */
+static void human_perf(const struct scut_perf* p)
+{
+        static const char* const names[PERF_EVENTS] = {
+                "instructions", "cycles", "cache misses", "branch misses", 
+                "TLB misses", "task clock", "page faults", "context switches"
+        };
+        char buf[MAX_MSG];
+        const char* sep = "> ";
+        int missing = 0;
+
+        for (int i = 0; i < PERF_EVENTS; ++i)
+        {
+                if (p->v[i] < 0)
+                {
+                        missing++;
+                }
+                else if (i == SCUT_PERF_TASK_CLOCK)
+                {
+                        snprintf(buf, MAX_MSG, "%s%.3f ms %s", sep, 
+                                 p->v[i] / 1e6, names[i]);
+                        say(buf);
+                        sep = ", ";
+                }
+                else
+                {
+                        snprintf(buf, MAX_MSG, "%s%lld %s", sep, 
+                                 p->v[i], names[i]);
+                        say(buf);
+                        sep = ", ";
+                }
+        }
+        for (int i = 0; i < PERF_EVENTS; ++i)
+        {
+                if (p->v[i] < 0)
+                {
+                        say(sep);
+                        say(names[i]);
+                        sep = --missing > 0 ? ", " : "";
+                }
+        }
+        if (sep[0] == 0)
+        {
+                say(" unavailable");
+        }
+        say("\n");
+}
+
+static void human_baseline(const struct scut_result* res)
+{
+        char buf[MAX_MSG];
+        int n;
+
+        n = snprintf(buf, 
+                     MAX_MSG,
+                     "> Baseline %.3f ns, now %.3f ns (%+.1f%%)",
+                     res->base.mean,
+                     res->sample.mean,
+                     (res->sample.mean / res->base.mean - 1) * 100);
+        if (res->confidence >= 0 && n > 0 && n < MAX_MSG)
+        {
+                n += snprintf(buf + n, 
+                              MAX_MSG - n,
+                              ", %.1f%% confidence it is slower",
+                              res->confidence * 100);
+        }
+        if (res->confidence >= 0 && res->tolerance > 0 && n < MAX_MSG)
+        {
+                snprintf(buf + n, 
+                         MAX_MSG - n,
+                         " by more than %g%%",
+                         res->tolerance * 100);
+        }
+        say(buf);
+        say("\n");
+}
+
+static void human_stress(const struct scut_stress* s)
+{
+        char buf[MAX_MSG];
+        int n;
+
+        n = snprintf(buf, 
+                     MAX_MSG, 
+                     "> Stress %d threads, %lld iterations in %.3f ms, %.0f/s", 
+                     s->threads, 
+                     s->iterations, 
+                     s->ns / 1e6, 
+                     s->ns > 0 ? s->iterations * 1e9 / s->ns : 0);
+        if (s->failed && n > 0 && n < MAX_MSG)
+        {
+                snprintf(buf + n, MAX_MSG - n, ", %d failed", s->failed);
+        }
+        say(buf);
+        say("\n");
+}
+
+static void human_failures(const struct scut_result* res)
+{
+        char buf[MAX_MSG];
+
+        for (int i = 0; i < res->recorded; ++i)
+        {
+                fail_msg(res->fail + i, buf, MAX_MSG);
+                say("> ");
+                say(buf);
+                say("\n");
+        }
+        if (res->failures > res->recorded)
+        {
+                snprintf(buf, 
+                         MAX_MSG, 
+                         "> %d more not recorded\n", 
+                         res->failures - res->recorded);
+                say(buf);
+        }
+}
+
+static void human_slowest(void)
+{
+        char buf[MAX_MSG];
+
+        snprintf(buf, MAX_MSG, "\nSlowest %d tests:\n", cur->slowest_len);
+        say(buf);
+        for (int i = 0; i < cur->slowest_len; ++i)
+        {
+                snprintf(buf, MAX_MSG, "%12.3f ms ", cur->slowest[i].ns / 1e6);
+                say(buf);
+                say(cur->slowest[i].name);
+                say("\n");
+        }
+}
+
+/* TAP version 13, with failure details in a YAML block */
+static void tap_suite_start(void)
+{
+        char buf[MAX_MSG];
+
+        cur->test_num = 0;
+        snprintf(buf, MAX_MSG, "TAP version 13\n# %s\n", cur->suite->name);
+        say(buf);
+}
+
+static void tap_test_start(struct scut_test* test)
+{
+        (void)test;
+        cur->test_num++;
+}
+
+static void tap_test_end(struct scut_test* test, 
+                         struct scut_result* res, 
+                         const char* captured)
+{
+        char buf[MAX_MSG];
+        char msg[MAX_MSG];
+
+        snprintf(buf, 
+                 MAX_MSG, 
+                 "%s %d - %s%s\n", 
+                 res->ret ? "not ok" : "ok", 
+                 cur->test_num, 
+                 test->name,
+                 res->cached ? " # SKIP cached" : "");
+        say(buf);
+
+        if (res->bench.ran)
+        {
+                snprintf(buf, 
+                         MAX_MSG, 
+                         "# %.2f ns/op, p50 %.2f, p90 %.2f, p99 %.2f, max %.2f ns\n",
+                         res->bench.ns_op,
+                         res->bench.p50,
+                         res->bench.p90,
+                         res->bench.p99,
+                         res->bench.max);
+                say(buf);
+        }
+
+        if (!res->ret && !(cur->flags & SCUT_VERBOSE))
+        {
+                return;
+        }
+
+        snprintf(buf, 
+                 MAX_MSG, 
+                 "  ---\n  result: %s\n  duration_ms: %.3f\n", 
+                 result_name(res),
+                 res->ns / 1e6);
+        say(buf);
+        if (result_msg(res, msg, MAX_MSG))
+        {
+                say("  message: \"");
+                say(msg);
+                say("\"\n");
+        }
+        if (res->recorded)
+        {
+                say("  failures:\n");
+        }
+        for (int i = 0; i < res->recorded; ++i)
+        {
+                const struct scut_failure* f = res->fail + i;
+
+                say("    - file: \"");
+                say_json(f->file);
+                snprintf(buf, MAX_MSG, "\"\n      line: %d\n      expr: \"", f->line);
+                say(buf);
+                say_json(f->expr);
+                say("\"\n      message: \"");
+                fail_msg(f, msg, MAX_MSG);
+                say_json(msg);
+                say("\"\n");
+        }
+        if (captured && *captured)
+        {
+                say("  output: |\n");
+                say_lines(captured, "    ");
+        }
+        say("  ...\n");
+}
+
+static void tap_suite_end(int count, int failed)
+{
+        char buf[MAX_MSG];
+
+        if (cur->skipped)
+        {
+                snprintf(buf, 
+                         MAX_MSG, 
+                         "# %d skipped, stopped after %d failed tests\n", 
+                         cur->skipped, 
+                         failed);
+                say(buf);
+        }
+        snprintf(buf, MAX_MSG, "1..%d\n", count);
+        say(buf);
+}
+
+/*
+ * The testsuite element carries the totals, so test cases are kept in
+ * memory until the end of the suite.
+ */
+static void junit_suite_start(void)
+{
+        cur->test_num = 0;
+        cur->body.len = 0;
+}
+
+static void junit_test_end(struct scut_test* test, 
+                           struct scut_result* res, 
+                           const char* captured)
+{
+        char buf[MAX_MSG];
+        char msg[MAX_MSG];
+
+        cur->sink = &cur->body;
+        say("    <testcase classname=\"");
+        say_xml(cur->suite->name);
+        say("\" name=\"");
+        say_xml(test->name);
+        snprintf(buf, MAX_MSG, "\" time=\"%.6f\"", res->ns / 1e9);
+        say(buf);
+        if (!res->ret && !res->cached && !(captured && *captured))
+        {
+                say("/>\n");
+                cur->sink = NULL;
+                return;
+        }
+        say(">\n");
+        if (res->cached)
+        {
+                say("      <skipped message=\"cached\"/>\n");
+        }
+        if (res->ret)
+        {
+                if (!result_msg(res, msg, MAX_MSG))
+                {
+                        snprintf(msg, MAX_MSG, "Test failed");
+                }
+                say("      <failure message=\"");
+                say_xml(msg);
+                snprintf(buf, 
+                         MAX_MSG, 
+                         "\" type=\"%s\"%s", 
+                         result_name(res), 
+                         res->recorded ? ">" : "/>\n");
+                say(buf);
+                for (int i = 0; i < res->recorded; ++i)
+                {
+                        fail_msg(res->fail + i, msg, MAX_MSG);
+                        say_xml(msg);
+                        say("\n");
+                }
+                if (res->recorded)
+                {
+                        say("</failure>\n");
+                }
+        }
+        if (captured && *captured)
+        {
+                say("      <system-out>");
+                say_xml(captured);
+                say("</system-out>\n");
+        }
+        say("    </testcase>\n");
+        cur->sink = NULL;
+}
+
+/* Skipped tests are listed, and counted in tests, as CI tools expect */
+static void junit_test_skip(struct scut_test* test)
+{
+        cur->sink = &cur->body;
+        say("    <testcase classname=\"");
+        say_xml(cur->suite->name);
+        say("\" name=\"");
+        say_xml(test->name);
+        say("\" time=\"0\">\n      <skipped message=\"fail fast\"/>\n    </testcase>\n");
+        cur->sink = NULL;
+}
+
+static void junit_suite_end(int count, int failed)
+{
+        char buf[MAX_MSG];
+
+        say("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n");
+        say("  <testsuite name=\"");
+        say_xml(cur->suite->name);
+        snprintf(buf, 
+                 MAX_MSG, 
+                 "\" tests=\"%d\" failures=\"%d\" errors=\"0\" skipped=\"%d\">\n", 
+                 count + cur->skipped, 
+                 failed,
+                 cur->skipped + cur->num_cached);
+        say(buf);
+        say_n(cur->body.data, cur->body.len);
+        say("  </testsuite>\n</testsuites>\n");
+}
+
+/* One JSON object per line and event */
+static void jsonl_suite_start(void)
+{
+        say("{\"event\":\"suite_start\",\"suite\":\"");
+        say_json(cur->suite->name);
+        say("\"}\n");
+}
+
+static void jsonl_test_start(struct scut_test* test)
+{
+        say("{\"event\":\"test_start\",\"name\":\"");
+        say_json(test->name);
+        say("\"}\n");
+}
+
+static void jsonl_test_end(struct scut_test* test, 
+                           struct scut_result* res, 
+                           const char* captured)
+{
+        char buf[MAX_MSG];
+        char msg[MAX_MSG];
+
+        say("{\"event\":\"test_end\",\"name\":\"");
+        say_json(test->name);
+        snprintf(buf, 
+                 MAX_MSG, 
+                 "\",\"result\":\"%s\",\"signal\":%d,\"ns\":%lld", 
+                 result_name(res),
+                 res->sig,
+                 res->ns);
+        say(buf);
+        if (result_msg(res, msg, MAX_MSG))
+        {
+                say(",\"message\":\"");
+                say_json(msg);
+                say("\"");
+        }
+        if (res->has_usage)
+        {
+                const struct scut_usage* u = &res->usage;
+
+                snprintf(buf, 
+                         MAX_MSG,
+                         ",\"usage\":{\"utime_ns\":%lld,\"stime_ns\":%lld,"
+                         "\"maxrss_kib\":%ld,\"minflt\":%ld,\"majflt\":%ld,"
+                         "\"nvcsw\":%ld,\"nivcsw\":%ld,"
+                         "\"read_bytes\":%lld,\"write_bytes\":%lld}",
+                         u->utime,
+                         u->stime,
+                         u->maxrss,
+                         u->minflt,
+                         u->majflt,
+                         u->nvcsw,
+                         u->nivcsw,
+                         u->rbytes,
+                         u->wbytes);
+                say(buf);
+        }
+        if (res->has_allocs)
+        {
+                const struct scut_allocs* a = &res->allocs;
+                long long blocks;
+                long long bytes;
+
+                alloc_leaked(a, &blocks, &bytes);
+                snprintf(buf, 
+                         MAX_MSG,
+                         ",\"allocs\":{\"count\":%lld,\"bytes\":%lld,"
+                         "\"peak_bytes\":%lld,\"leaked_blocks\":%lld,"
+                         "\"leaked_bytes\":%lld}",
+                         a->allocs,
+                         a->bytes,
+                         a->peak,
+                         blocks,
+                         bytes);
+                say(buf);
+        }
+        if (res->has_perf)
+        {
+                static const char* const keys[PERF_EVENTS] = {
+                        "instructions", "cycles", "cache_misses", 
+                        "branch_misses", "tlb_misses", "task_clock_ns", 
+                        "page_faults", "context_switches"
+                };
+
+                for (int i = 0; i < PERF_EVENTS; ++i)
+                {
+                        if (res->perf.v[i] < 0)
+                        {
+                                snprintf(buf, MAX_MSG, "%s\"%s\":null", 
+                                         i ? "," : ",\"perf\":{", keys[i]);
+                        }
+                        else
+                        {
+                                snprintf(buf, MAX_MSG, "%s\"%s\":%lld", 
+                                         i ? "," : ",\"perf\":{", keys[i], 
+                                         res->perf.v[i]);
+                        }
+                        say(buf);
+                }
+                say("}");
+        }
+        if (res->has_baseline)
+        {
+                snprintf(buf, 
+                         MAX_MSG,
+                         ",\"baseline\":{\"samples\":%lld,\"ns\":%.3f,"
+                         "\"now_samples\":%lld,\"now_ns\":%.3f,"
+                         "\"tolerance\":%g,\"confidence\":%.4f}",
+                         res->base.n,
+                         res->base.mean,
+                         res->sample.n,
+                         res->sample.mean,
+                         res->tolerance > 0 ? res->tolerance : 0,
+                         res->confidence);
+                say(buf);
+        }
+        if (res->bench.ran)
+        {
+                const struct scut_bench_result* b = &res->bench;
+
+                snprintf(buf, 
+                         MAX_MSG,
+                         ",\"bench\":{\"ns_op\":%.3f,\"bytes_op\":%llu,"
+                         "\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+                         b->ns_op,
+                         b->bytes,
+                         b->p50,
+                         b->p90,
+                         b->p99,
+                         b->max);
+                say(buf);
+        }
+        if (res->has_stress)
+        {
+                const struct scut_stress* st = &res->stress;
+
+                snprintf(buf, 
+                         MAX_MSG,
+                         ",\"stress\":{\"threads\":%d,\"iterations\":%lld,"
+                         "\"ns\":%lld,\"per_s\":%.0f,\"failed_threads\":%d}",
+                         st->threads,
+                         st->iterations,
+                         st->ns,
+                         st->ns > 0 ? st->iterations * 1e9 / st->ns : 0,
+                         st->failed);
+                say(buf);
+        }
+        if (res->failures)
+        {
+                jsonl_failures(res);
+        }
+        if (captured && *captured)
+        {
+                say(",\"output\":\"");
+                say_json(captured);
+                say("\"");
+        }
+        say("}\n");
+}
+
+/* The failed expectations with their values, null where not finite */
+static void jsonl_failures(const struct scut_result* res)
+{
+        static const char* const tols[] = {"abs", "rel", "ulp"};
+        char buf[MAX_MSG];
+        char msg[MAX_MSG];
+
+        snprintf(buf, MAX_MSG, ",\"expectations_failed\":%d,\"failures\":[", res->failures);
+        say(buf);
+        for (int i = 0; i < res->recorded; ++i)
+        {
+                const struct scut_failure* f = res->fail + i;
+
+                say(i ? ",{\"file\":\"" : "{\"file\":\"");
+                say_json(f->file);
+                snprintf(buf, MAX_MSG, "\",\"line\":%d,\"expr\":\"", f->line);
+                say(buf);
+                say_json(f->expr);
+                say("\",\"message\":\"");
+                fail_msg(f, msg, MAX_MSG);
+                say_json(msg);
+                say("\"");
+                switch (f->kind)
+                {
+                case FAIL_IE:
+                        snprintf(buf, 
+                                 MAX_MSG, 
+                                 ",\"found\":%lld,\"expected\":%lld", 
+                                 f->found, 
+                                 f->expected);
+                        break;
+                case FAIL_BOOL:
+                        snprintf(buf, 
+                                 MAX_MSG, 
+                                 ",\"expected\":%s", 
+                                 f->expected ? "true" : "false");
+                        break;
+                default:
+                        snprintf(buf, 
+                                 MAX_MSG, 
+                                 isfinite(f->x) ? ",\"found\":%.17g" : ",\"found\":null", 
+                                 f->x);
+                        say(buf);
+                        snprintf(buf, 
+                                 MAX_MSG, 
+                                 isfinite(f->y) ? ",\"expected\":%.17g" : ",\"expected\":null", 
+                                 f->y);
+                        say(buf);
+                        snprintf(buf, 
+                                 MAX_MSG, 
+                                 ",\"tolerance\":%.17g,\"tolerance_kind\":\"%s\"", 
+                                 f->tol, 
+                                 tols[f->tol_kind]);
+                        break;
+                }
+                say(buf);
+                say("}");
+        }
+        say("]");
+}
+
+static void jsonl_suite_end(int count, int failed)
+{
+        char buf[MAX_MSG];
+
+        say("{\"event\":\"suite_end\",\"suite\":\"");
+        say_json(cur->suite->name);
+        snprintf(buf, 
+                 MAX_MSG, 
+                 "\",\"performed\":%d,\"failed\":%d", 
+                 count - cur->num_cached, 
+                 failed);
+        say(buf);
+        if (cur->num_cached)
+        {
+                snprintf(buf, MAX_MSG, ",\"cached\":%d", cur->num_cached);
+                say(buf);
+        }
+        if (cur->skipped)
+        {
+                snprintf(buf, MAX_MSG, ",\"skipped\":%d", cur->skipped);
+                say(buf);
+        }
+        say("}\n");
+}
+
+static size_t mem_first(const unsigned char* a, 
+                        const unsigned char* b, 
+                        size_t n)
+{
+        size_t i = 0;
+
+        while (i < n && a[i] == b[i])
+        {
+                i++;
+        }
+
+        return i;
+}
+
+/* Differing bytes, a word at a time */
+static size_t mem_count(const unsigned char* a, 
+                        const unsigned char* b, 
+                        size_t n)
+{
+        const unsigned long long low = 0x7f7f7f7f7f7f7f7fULL;
+        size_t count = 0;
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+                unsigned long long x;
+                unsigned long long y;
+
+                memcpy(&x, a + i, 8);
+                memcpy(&y, b + i, 8);
+                x ^= y;
+                /* The high bit of every byte that is not zero */
+                x = (((x & low) + low) | x) & ~low;
+#if defined(__GNUC__)
+                count += __builtin_popcountll(x);
+#else
+                for (; x; x &= x - 1)
+                {
+                        count++;
+                }
+#endif
+        }
+        for (; i < n; ++i)
+        {
+                count += a[i] != b[i];
+        }
+
+        return count;
+}
+
+/* One row of 16 bytes of both buffers, marking the differences */
+static void mem_dump(const unsigned char* a, 
+                     const unsigned char* b, 
+                     size_t n, 
+                     size_t row)
+{
+        char found[16 * 3 + 1];
+        char expected[16 * 3 + 1];
+        char mark[16 * 3 + 1];
+        int last = 0;
+
+        found[0] = expected[0] = mark[0] = 0;
+        for (size_t i = row; i < row + 16 && i < n; ++i)
+        {
+                int k = (int)(i - row) * 3;
+
+                snprintf(found + k, 4, " %02x", a[i]);
+                snprintf(expected + k, 4, " %02x", b[i]);
+                snprintf(mark + k, 4, "%s", a[i] != b[i] ? " ^^" : "   ");
+                if (a[i] != b[i])
+                {
+                        last = k + 3;
+                }
+        }
+        mark[last] = 0;
+        printf("  %08zx found   %s\n", row, found);
+        printf("           expected%s\n", expected);
+        if (last)
+        {
+                printf("                   %s\n", mark);
+        }
+}
+
+/*
+ * Whether any element may be outside the tolerance, OR-ing a flag
+ * per element without branches. Floats are compared as floats,
+ * against the largest float not above the tolerance. Equal infinities
+ * and NaNs are left to float_error.
+ */
+static int float_over(const void* found, 
+                      const void* expected, 
+                      size_t n, 
+                      size_t size, 
+                      int kind, 
+                      double tol)
+{
+        unsigned long long ulps = tol < 1e19 ? (unsigned long long)tol : ~0ULL;
+        unsigned int ulps32 = ulps < 0xffffffffULL ? (unsigned int)ulps : 0xffffffffU;
+        float tolf = (float)tol;
+        const double* a = found;
+        const double* b = expected;
+        const float* af = found;
+        const float* bf = expected;
+        unsigned long long over = 0;
+        unsigned int overf = 0;
+
+        if (tolf > tol)
+        {
+                tolf = nextafterf(tolf, 0);
+        }
+        switch (kind + 3 * (size == sizeof(float)))
+        {
+        case SCUT_TOL_ABS:
+                for (size_t i = 0; i < n; ++i)
+                {
+                        over |= !(fabs(a[i] - b[i]) <= tol);
+                }
+                break;
+        case SCUT_TOL_REL:
+                for (size_t i = 0; i < n; ++i)
+                {
+                        double m = fabs(a[i]) > fabs(b[i]) ? fabs(a[i]) : fabs(b[i]);
+
+                        over |= !(fabs(a[i] - b[i]) <= tol * m);
+                }
+                break;
+        case SCUT_TOL_ULP:
+                for (size_t i = 0; i < n; ++i)
+                {
+                        unsigned long long x = float_key(a[i], 0);
+                        unsigned long long y = float_key(b[i], 0);
+
+                        over |= ((x > y ? x - y : y - x) > ulps) | 
+                                (a[i] != a[i]) | (b[i] != b[i]);
+                }
+                break;
+        case 3 + SCUT_TOL_ABS:
+                for (size_t i = 0; i < n; ++i)
+                {
+                        overf |= !(fabsf(af[i] - bf[i]) <= tolf);
+                }
+                break;
+        case 3 + SCUT_TOL_REL:
+                for (size_t i = 0; i < n; ++i)
+                {
+                        float m = fabsf(af[i]) > fabsf(bf[i]) ? fabsf(af[i]) : fabsf(bf[i]);
+
+                        overf |= !(fabsf(af[i] - bf[i]) <= tolf * m);
+                }
+                break;
+        default:
+                for (size_t i = 0; i < n; ++i)
+                {
+                        unsigned int x;
+                        unsigned int y;
+
+                        memcpy(&x, af + i, sizeof(x));
+                        memcpy(&y, bf + i, sizeof(y));
+                        x = (x >> 31) ? -x : x | 0x80000000U;
+                        y = (y >> 31) ? -y : y | 0x80000000U;
+                        overf |= ((x > y ? x - y : y - x) > ulps32) | 
+                                (af[i] != af[i]) | (bf[i] != bf[i]);
+                }
+                break;
+        }
+
+        return over != 0 || overf != 0;
+}
+
+static double float_at(const void* p, size_t size, size_t i)
+{
+        return size == sizeof(float) ? ((const float*)p)[i] : ((const double*)p)[i];
+}
+
+/* The error of one element, 0 for two NaNs or equal infinities */
+static double float_error(double x, double y, int single, int kind)
+{
+        unsigned long long a;
+        unsigned long long b;
+
+        if (x != x || y != y)
+        {
+                return x != x && y != y ? 0 : HUGE_VAL;
+        }
+        if (x == y)
+        {
+                return 0;
+        }
+        if (kind == SCUT_TOL_ABS)
+        {
+                return fabs(x - y);
+        }
+        if (kind == SCUT_TOL_REL)
+        {
+                if (fabs(x) == HUGE_VAL || fabs(y) == HUGE_VAL)
+                {
+                        return HUGE_VAL;
+                }
+                return fabs(x - y) / (fabs(x) > fabs(y) ? fabs(x) : fabs(y));
+        }
+        a = float_key(x, single);
+        b = float_key(y, single);
+
+        return (double)(a > b ? a - b : b - a);
+}
+
+/*
+ * The bits of a float or double as an unsigned integer in the same
+ * order as the values, so the difference of two is their distance in
+ * ULPs. Both zeros have the same key.
+ */
+static unsigned long long float_key(double v, int single)
+{
+        if (single)
+        {
+                float f = (float)v;
+                unsigned int u;
+
+                memcpy(&u, &f, sizeof(u));
+                return (u >> 31) ? (unsigned int)-u : u | 0x80000000U;
+        }
+        else
+        {
+                unsigned long long u;
+
+                memcpy(&u, &v, sizeof(u));
+                return (u >> 63) ? -u : u | 0x8000000000000000ULL;
+        }
+}
+
+static void float_tol(char* buf, size_t len, int kind, double tol)
+{
+        switch (kind)
+        {
+        case SCUT_TOL_REL:
+                snprintf(buf, len, "%g relative", tol);
+                break;
+        case SCUT_TOL_ULP:
+                snprintf(buf, len, "%g ulp", tol);
+                break;
+        default:
+                snprintf(buf, len, "%g", tol);
+                break;
+        }
+}
+
+/* Checked before every call, so it must not take the lock */
+static int stress_stopped(struct scut_stress_run* run)
+{
+#if defined(__GNUC__)
+        return __atomic_load_n(&run->stop, __ATOMIC_RELAXED);
+#else
+        return run->stop;
+#endif
+}
+
+/* Count the thread as finished, scut_stress waits for all of them */
+static void stress_done(struct scut_stress_run* run)
+{
+        pthread_mutex_lock(&run->lock);
+        run->finished++;
+        pthread_cond_broadcast(&run->cond);
+        pthread_mutex_unlock(&run->lock);
+}
+
+static void* stress_thread(void* arg)
+{
+        struct scut_stress_thread* t = arg;
+        struct scut_stress_run* run = t->run;
+
+        pthread_mutex_lock(&run->lock);
+        run->ready++;
+        pthread_cond_broadcast(&run->cond);
+        while (run->go == 0)
+        {
+                pthread_cond_wait(&run->cond, &run->lock);
+        }
+        pthread_mutex_unlock(&run->lock);
+        if (run->go < 0)
+        {
+                stress_done(run);
+                return NULL;
+        }
+
+        /* A fault ends this thread only, see sig_trap */
+        if (sigsetjmp(t->env, 1))
+        {
+                stress_self = NULL;
+                t->failed = 1;
+                stress_done(run);
+                return NULL;
+        }
+        stress_self = t;
+        for (long long i = 0; i < run->iterations && !stress_stopped(run); ++i)
+        {
+                if (run->fn(t->thread, i))
+                {
+                        t->failed = 1;
+                        break;
+                }
+                t->done++;
+        }
+        stress_self = NULL;
+        stress_done(run);
+
+        return NULL;
+}
+
+/*
+ * Keep a failed expectation for the report, or print it outside a test.
+ * Threads reserve a slot with an atomic increment, and fill it in.
+ */
+static void fail_add(const struct scut_failure* f)
+{
+        struct scut_run* run = cur && cur->in_test ? cur : test_run;
+        char msg[MAX_MSG];
+        int i;
+
+        if (run == NULL)
+        {
+                fail_msg(f, msg, MAX_MSG);
+                printf("%s\n", msg);
+                return;
+        }
+#if defined(__GNUC__)
+        i = __sync_fetch_and_add(&run->num_failures, 1);
+#else
+        pthread_mutex_lock(&fail_lock);
+        i = run->num_failures++;
+        pthread_mutex_unlock(&fail_lock);
+#endif
+        if (i < MAX_FAILURES)
+        {
+                run->failures[i] = *f;
+        }
+}
+
+static int fail_msg(const struct scut_failure* f, char* buf, size_t len)
+{
+        int digits = f->single ? 9 : 17;
+        char limit[64];
+
+        switch (f->kind)
+        {
+        case FAIL_IE:
+                return snprintf(buf, 
+                                len, 
+                                "Expectation failed, %s: found %lld, expected %lld: %s+%d", 
+                                f->expr, 
+                                f->found, 
+                                f->expected, 
+                                f->file, 
+                                f->line);
+        case FAIL_BOOL:
+                return snprintf(buf, 
+                                len, 
+                                "Expectation failed, %s: expected %s: %s+%d", 
+                                f->expr, 
+                                f->expected ? "true" : "false", 
+                                f->file, 
+                                f->line);
+        default:
+                float_tol(limit, sizeof(limit), f->tol_kind, f->tol);
+                return snprintf(buf, 
+                                len, 
+                                "Expectation failed, %s: found %.*g, expected %.*g, error %.*g is more than %s: %s+%d", 
+                                f->expr, 
+                                digits, 
+                                f->x, 
+                                digits, 
+                                f->y, 
+                                FLOAT_ERROR_DIGITS(f->tol_kind), 
+                                float_error(f->x, f->y, f->single, f->tol_kind), 
+                                limit, 
+                                f->file, 
+                                f->line);
+        }
+}
+
+/*
+ * Allocation tracking nests, the hooks count while the depth of the
+ * calling thread is above zero.
+ */
+static void alloc_track(int on)
+{
+#if defined(ALLOC_HOOKS)
+        if (on)
+        {
+                if (alloc_depth++ == 0)
+                {
+                        __sync_fetch_and_add(&alloc_threads, 1);
+                }
+        }
+        else if (alloc_depth > 0 && --alloc_depth == 0)
+        {
+                __sync_fetch_and_sub(&alloc_threads, 1);
+        }
+#else
+        (void)on;
+#endif
+}
+
+/* Stop tracking, returning the depth to resume with */
+static int alloc_pause(void)
+{
+        int depth = alloc_depth;
+
+#if defined(ALLOC_HOOKS)
+        if (depth)
+        {
+                alloc_depth = 0;
+                __sync_fetch_and_sub(&alloc_threads, 1);
+        }
+#endif
+        return depth;
+}
+
+static void alloc_resume(int depth)
+{
+        alloc_pause();
+#if defined(ALLOC_HOOKS)
+        if (depth)
+        {
+                alloc_depth = depth;
+                __sync_fetch_and_add(&alloc_threads, 1);
+        }
+#else
+        (void)depth;
+#endif
+}
+
+/*
+ * Blocks still allocated when the test returned. Freeing blocks from
+ * before the test makes the counts go down, which is not a leak.
+ */
+static void alloc_leaked(const struct scut_allocs* a, 
+                         long long* blocks, 
+                         long long* bytes)
+{
+        *blocks = a->allocs > a->frees ? a->allocs - a->frees : 0;
+        *bytes = a->live > 0 ? a->live : 0;
+}
+
+#if defined(ALLOC_HOOKS)
+extern void* __libc_malloc(size_t);
+extern void* __libc_calloc(size_t, size_t);
+extern void* __libc_realloc(void*, size_t);
+extern void __libc_free(void*);
+extern void* __libc_memalign(size_t, size_t);
+
+static void alloc_add(void* p)
+{
+        long long n = (long long)malloc_usable_size(p);
+
+        alloc_total++;
+        alloc_stats.allocs++;
+        alloc_stats.bytes += n;
+        alloc_stats.live += n;
+        if (alloc_stats.live > alloc_stats.peak)
+        {
+                alloc_stats.peak = alloc_stats.live;
+        }
+}
+
+static void alloc_del(void* p)
+{
+        alloc_stats.frees++;
+        alloc_stats.live -= (long long)malloc_usable_size(p);
+}
+
+void* malloc(size_t n)
+{
+        void* p = __libc_malloc(n);
+
+        if (alloc_threads && alloc_depth && p)
+        {
+                alloc_add(p);
+        }
+
+        return p;
+}
+
+void* calloc(size_t n, size_t size)
+{
+        void* p = __libc_calloc(n, size);
+
+        if (alloc_threads && alloc_depth && p)
+        {
+                alloc_add(p);
+        }
+
+        return p;
+}
+
+void* realloc(void* p, size_t n)
+{
+        long long old;
+        void* q;
+
+        if (!alloc_threads || !alloc_depth)
+        {
+                return __libc_realloc(p, n);
+        }
+        old = p ? (long long)malloc_usable_size(p) : 0;
+        q = __libc_realloc(p, n);
+        if (p && (q || n == 0))
+        {
+                alloc_stats.frees++;
+                alloc_stats.live -= old;
+        }
+        if (q)
+        {
+                alloc_add(q);
+        }
+
+        return q;
+}
+
+void free(void* p)
+{
+        if (alloc_threads && alloc_depth && p)
+        {
+                alloc_del(p);
+        }
+        __libc_free(p);
+}
+
+/* 
+ * The aligned allocations are freed with free, so they are counted too.
+ * valloc and pvalloc are obsolete and not counted.
+ */
+void* memalign(size_t align, size_t n)
+{
+        void* p = __libc_memalign(align, n);
+
+        if (alloc_threads && alloc_depth && p)
+        {
+                alloc_add(p);
+        }
+
+        return p;
+}
+
+void* aligned_alloc(size_t align, size_t n)
+{
+        return memalign(align, n);
+}
+
+int posix_memalign(void** p, size_t align, size_t n)
+{
+        void* q;
+
+        if (align % sizeof(void*) || (align & (align - 1)) || align == 0)
+        {
+                return EINVAL;
+        }
+        q = memalign(align, n);
+        if (q == NULL)
+        {
+                return ENOMEM;
+        }
+        *p = q;
+
+        return 0;
+}
+#endif
+
+#if defined(__linux__)
+long syscall(long, ...);
+
+/*
+ * Open the counters for the calling thread, in user space only so
+ * they work with the default perf_event_paranoid. Forked workers
+ * inherit the counters of their parent, and open their own.
+ */
+static void perf_open(void)
+{
+        static const struct
+        {
+                unsigned type;
+                unsigned long long config;
+        } events[PERF_EVENTS] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | 
+                 (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+                {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+                {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+                {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}
+        };
+        pid_t pid = getpid();
+
+        if (cur->perf_pid == pid)
+        {
+                return;
+        }
+        perf_close();
+        cur->perf_pid = pid;
+        for (int i = 0; i < PERF_EVENTS; ++i)
+        {
+                struct perf_event_attr attr;
+
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = events[i].type;
+                attr.config = events[i].config;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.inherit = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | 
+                        PERF_FORMAT_TOTAL_TIME_RUNNING;
+                cur->perf_fd[i] = (int)syscall(SYS_perf_event_open, 
+                                               &attr, 
+                                               0, 
+                                               -1, 
+                                               -1, 
+                                               0);
+                if (cur->perf_fd[i] >= 0)
+                {
+                        fcntl(cur->perf_fd[i], F_SETFD, FD_CLOEXEC);
+                }
+        }
+}
+
+static void perf_close(void)
+{
+        if (cur->perf_pid == 0)
+        {
+                return;
+        }
+        for (int i = 0; i < PERF_EVENTS; ++i)
+        {
+                if (cur->perf_fd[i] >= 0)
+                {
+                        close(cur->perf_fd[i]);
+                }
+        }
+        cur->perf_pid = 0;
+}
+
+/*
+ * The count of a counter, scaled up by the time it was enabled over
+ * the time it ran when the kernel had to multiplex the hardware.
+ */
+static long long perf_value(int fd)
+{
+        unsigned long long v[3];
+
+        if (fd < 0 || read(fd, v, sizeof(v)) != (ssize_t)sizeof(v))
+        {
+                return -1;
+        }
+        if (v[2] > 0 && v[2] < v[1])
+        {
+                return (long long)((double)v[0] * v[1] / v[2]);
+        }
+
+        return (long long)v[0];
+}
+#else
+static void perf_open(void)
+{
+        for (int i = 0; i < PERF_EVENTS; ++i)
+        {
+                cur->perf_fd[i] = -1;
+        }
+        cur->perf_pid = getpid();
+}
+
+static void perf_close(void)
+{
+        cur->perf_pid = 0;
+}
+
+static long long perf_value(int fd)
+{
+        (void)fd;
+
+        return -1;
+}
+#endif
+
+static void perf_read(struct scut_perf* p)
+{
+        perf_open();
+        for (int i = 0; i < PERF_EVENTS; ++i)
+        {
+                p->v[i] = perf_value(cur->perf_fd[i]);
+        }
+}
+
+/*
+ * Sample the resource usage of the process. Read and written bytes come
+ * from /proc/self/io where it exists, and are estimated from the block
+ * counts elsewhere.
+ */
+static void usage_get(struct scut_usage* u)
+{
+        struct rusage ru;
+
+        getrusage(RUSAGE_SELF, &ru);
+        u->utime = ru.ru_utime.tv_sec * 1000000000LL + ru.ru_utime.tv_usec * 1000LL;
+        u->stime = ru.ru_stime.tv_sec * 1000000000LL + ru.ru_stime.tv_usec * 1000LL;
+        u->maxrss = ru.ru_maxrss;
+        u->minflt = ru.ru_minflt;
+        u->majflt = ru.ru_majflt;
+        u->nvcsw = ru.ru_nvcsw;
+        u->nivcsw = ru.ru_nivcsw;
+        u->rbytes = ru.ru_inblock * 512LL;
+        u->wbytes = ru.ru_oublock * 512LL;
+        u->own = 0;
+
+#if defined(__linux__)
+        {
+                char buf[512];
+                char* p;
+                ssize_t n;
+                int fd = open("/proc/self/io", O_RDONLY);
+
+                if (fd < 0)
+                {
+                        return;
+                }
+                n = read(fd, buf, sizeof(buf) - 1);
+                close(fd);
+                if (n <= 0)
+                {
+                        return;
+                }
+                buf[n] = 0;
+                if ((p = strstr(buf, "rchar:")))
+                {
+                        u->rbytes = strtoll(p + 6, NULL, 10);
+                        u->own = n;
+                }
+                if ((p = strstr(buf, "wchar:")))
+                {
+                        u->wbytes = strtoll(p + 6, NULL, 10);
+                }
+        }
+#endif
+}
+
+static void usage_diff(struct scut_usage* u, const struct scut_usage* before)
 {
-        if (suite)
+        u->utime -= before->utime;
+        u->stime -= before->stime;
+        u->maxrss -= before->maxrss;
+        u->minflt -= before->minflt;
+        u->majflt -= before->majflt;
+        u->nvcsw -= before->nvcsw;
+        u->nivcsw -= before->nivcsw;
+        u->rbytes -= before->rbytes + before->own;
+        u->wbytes -= before->wbytes;
+}
+
+static int get_jobs(int flags)
+{
+        long jobs = cur->env_jobs;
+
+        if (jobs < 1 && (flags & SCUT_PARALLEL))
         {
-                scut_destroy();
+                jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        if (jobs < 1 || cur->count - cur->num_cached < 2)
+        {
+                jobs = 1;
         }
 
-        suite = malloc(sizeof(struct scut_suite));
+        return (int)jobs;
+}
 
-        if (suite)
+static int get_timeout(struct scut_test* test)
+{
+        if (test->timeout)
         {
-                int cap = 64;
-                suite->cap = 64;
-                suite->count = 0;
-                suite->name = name;
-                suite->tests = malloc(sizeof(struct scut_test) * cap);
-                suite->sig_catched = malloc(sizeof(int) * MAX_SIG);
-                suite->sig_expected = malloc(sizeof(int) * MAX_SIG);
-                suite->catch_sig_pos = 0;
-                suite->exp_sig_pos = 0;
-                if (!suite->tests)
-                {
-                        free(suite);
-                        suite = NULL;
-                }
-                pthread_sigmask(SIG_SETMASK, NULL, &suite->sigmask);
+                return test->timeout;
+        }
+        if (cur->suite->timeout)
+        {
+                return cur->suite->timeout;
         }
+
+        return cur->env_timeout;
 }
 
-int scut_add(int (*test)(void), const char* name)
+/*
+ * Arm (or with 0 disarm) the per test watchdog. It fires SIGALRM, which
+ * sig_trap turns into a longjmp back to run_test once the deadline has
+ * passed.
+ */
+static void watchdog(int ms)
 {
-        if (suite->cap == suite->count)
+        struct itimerval it;
+
+        if (ms < 1 && cur->deadline == 0)
         {
-                printf("Can not add more tests\n");
-                return 1;
+                return;
         }
-        
-        if (test == NULL)
+
+        memset(&it, 0, sizeof(it));
+        if (ms > 0)
         {
-                return 1;
+                it.it_value.tv_sec = ms / 1000;
+                it.it_value.tv_usec = (ms % 1000) * 1000;
+                /* Keep firing if the first one is lost to an expected SIGALRM */
+                it.it_interval.tv_usec = 10000;
+                cur->deadline = now_ns() + ms * 1000000LL;
         }
-
-        if (name == NULL)
+        else
         {
-                return 1;
+                cur->deadline = 0;
         }
+        setitimer(ITIMER_REAL, &it, NULL);
+}
+
+static long long now_ns(void)
+{
+        struct timespec ts;
 
-        suite->tests[suite->count].test = test;
-        suite->tests[suite->count].name = name;
-        suite->count++;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
 
-        return 0;
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
-int scut_run(int flags)
+static int spawn_worker(struct scut_worker* workers, int n, int i)
 {
-        struct scut_test* test;
-        char buf[MAX_MSG];
-        int count = 0;
-        int ret;
-        int failed = 0;
-        int fds[2];
+        struct scut_worker* w = workers + i;
+        int cmd[2];
+        int res[2];
 
-        /* Disable buffering */
-        setbuf(stdout, NULL);
+        if (pipe(cmd))
+        {
+                return 1;
+        }
+        if (pipe(res))
+        {
+                close(cmd[0]);
+                close(cmd[1]);
+                return 1;
+        }
 
-        /* Capture stdout */
-        out = 1;
-        if (pipe(fds) == 0) 
+        w->killed = 0;
+        w->ran = 0;
+        w->pid = fork();
+        if (w->pid == 0)
         {
-                out = dup(1);
-                if (out > -1 && dup2(fds[1], 1) > -1)
+                /* Only keep the pipes to the parent */
+                for (int j = 0; j < n; ++j)
                 {
-                        if (fcntl(fds[0], F_SETFL, O_NONBLOCK) == -1)
+                        if (j != i && workers[j].pid > 0)
                         {
-                                close(out);
-                                close(fds[0]);
-                                close(fds[1]);
-                                out = 1;
+                                close(workers[j].cmd);
+                                close(workers[j].res);
                         }
                 }
-                else
-                {
-                        close(out);
-                        close(fds[0]);
-                        close(fds[1]);
-                        out = 1;
-                }
+                close(cmd[1]);
+                close(res[0]);
+                worker_main(cmd[0], res[1]);
         }
-        if (out == 1)
+        close(cmd[0]);
+        close(res[1]);
+        if (w->pid < 0)
         {
-                printf("Failed to capture stdout\n");
+                close(cmd[1]);
+                close(res[0]);
+                return 1;
         }
+        w->cmd = cmd[1];
+        w->res = res[0];
 
-        snprintf(buf, MAX_MSG, "> Running suite %s%s%s\n", BOLD, 
-                 suite->name, 
-                 BOLDOFF);
-        say(buf);
+        return 0;
+}
+
+/* Close the pipes of a worker and wait for it, returning its status */
+static int stop_worker(struct scut_worker* w)
+{
+        int status = 0;
+
+        close(w->cmd);
+        close(w->res);
+        while (waitpid(w->pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+
+        return status;
+}
 
-        while (count < suite->count)
+static void worker_main(int cmd, int res)
+{
+        int fd;
+        int t;
+
+        /* 
+         * Only this thread was forked, so locks held by other threads are
+         * never released. A worker owns its stdout and must not take them.
+         */
+        cur->worker = 1;
+        test_running = 0;
+        parallel_runs = 0;
+        pthread_sigmask(SIG_SETMASK, &cur->sigmask, NULL);
+        if ((fd = capture_file()) < 0 || dup2(fd, 1) < 0)
+        {
+                _exit(1);
+        }
+        sig_setup();
+
+        while (read_all(cmd, &t, sizeof(t)) == 0 && t >= 0)
         {
+                struct scut_result r;
                 char* captured;
-                int jmp;
-                
-                test = suite->tests + count++;
-                snprintf(buf, MAX_MSG, "Running %16s: ", test->name);
-                say(buf);
 
-                prepare_test();
-                jmp = setjmp(suite->env);
-                if (jmp == 0)
+                run_test(test_at(t), fd, &r, &captured);
+                if (write_all(res, &r, sizeof(r)) || 
+                    write_all(res, captured, r.len) ||
+                    write_all(res, r.fail, sizeof(*r.fail) * r.recorded))
                 {
-                        ret = test->test();
+                        _exit(1);
                 }
-                else
-                {
-                        // Must restore signal mask
-                        sigprocmask(SIG_SETMASK, &suite->sigmask, NULL);
+                free(captured);
+        }
 
-                        ret = 1;
-                }
+        _exit(0);
+}
 
-                captured = drain(fds[0]);
+static int read_all(int fd, void* buf, size_t len)
+{
+        char* p = buf;
 
-                if (ret)
-                {
-                        failed++;
-                        snprintf(buf, MAX_MSG, BOLD "FAILED" BOLDOFF "\n");
-                        say(buf);
+        while (len > 0)
+        {
+                ssize_t n = read(fd, p, len);
 
-                        if (jmp)
-                        {
-                                snprintf(buf, MAX_MSG, "> Killed by signal %d\n", jmp);
-                                say(buf);
-                        }
+                if (n < 0 && errno == EINTR)
+                {
+                        continue;
                 }
-                else
+                if (n <= 0)
                 {
-                        snprintf(buf, MAX_MSG, BOLD "Ok" BOLDOFF "\n");
-                        say(buf);
+                        return 1;
                 }
+                p += n;
+                len -= n;
+        }
+
+        return 0;
+}
+
+static int write_all(int fd, const void* buf, size_t len)
+{
+        const char* p = buf;
+
+        while (len > 0)
+        {
+                ssize_t n = write(fd, p, len);
 
-                if ((ret || (flags & SCUT_VERBOSE)) && strlen(captured))
+                if (n < 0 && errno == EINTR)
                 {
-                        snprintf(buf, MAX_MSG, ">>> Captured output <<<\n\n");
-                        say(buf);
-                        say(captured);
-                        snprintf(buf, MAX_MSG, "\n>>> End of output <<<\n");
-                        say(buf);
+                        continue;
                 }
-
-                free(captured);
+                if (n <= 0)
+                {
+                        return 1;
+                }
+                p += n;
+                len -= n;
         }
 
-        snprintf(buf, MAX_MSG, "\nResult: %d performed\n", count);
-        say(buf);
-        if (failed)
+        return 0;
+}
+
+static void prepare_test(void)
+{
+        sigemptyset(&cur->sig_expected);
+        sigemptyset(&cur->sig_caught);
+        cur->num_failures = 0;
+        cur->has_stress = 0;
+}
+
+static void say(const char* m)
+{
+        say_n(m, strlen(m));
+}
+
+/*
+ * Report output is collected in cur->obuf and written in large chunks, or
+ * appended to cur->sink when a reporter needs to hold it back.
+ */
+static void say_n(const char* m, size_t len)
+{
+        if (cur->sink)
         {
-                snprintf(buf, MAX_MSG, "Result: %d failed tests\n", failed);
-                say(buf);
+                if (cur->sink->len + len > cur->sink->cap)
+                {
+                        size_t cap = cur->sink->cap ? cur->sink->cap : OUT_BUF;
+                        char* data;
 
-                snprintf(buf, MAX_MSG, "Suite %s%s FAILED%s\n", 
-                         BOLD,
-                         suite->name,
-                         BOLDOFF);
-                say(buf);
+                        while (cap < cur->sink->len + len)
+                        {
+                                cap *= 2;
+                        }
+                        data = realloc(cur->sink->data, cap);
+                        if (data == NULL)
+                        {
+                                return;
+                        }
+                        cur->sink->data = data;
+                        cur->sink->cap = cap;
+                }
+                memcpy(cur->sink->data + cur->sink->len, m, len);
+                cur->sink->len += len;
+                return;
         }
-        else 
+
+        if (cur->olen + len > OUT_BUF)
         {
-                snprintf(buf, MAX_MSG, "Suite %s%s SUCCESS%s\n",
-                         BOLD,
-                         suite->name,
-                         BOLDOFF);
-                say(buf);
+                flush(len > OUT_BUF);
+                if (len > OUT_BUF)
+                {
+                        write_out(m, len);
+                        return;
+                }
         }
-
-        // Restore stdout
-        if (out != 1) 
+        if (cur->olen == 0)
         {
-                close(fds[0]);
-                close(fds[1]);
-                dup2(out, 1);
-                close(out);
+                cur->opid = getpid();
         }
-
-        return failed;
+        memcpy(cur->obuf + cur->olen, m, len);
+        cur->olen += len;
 }
 
-void scut_expect_sig(int signum)
+static void say_json(const char* m)
 {
-        if (suite->exp_sig_pos >= MAX_SIG)
+        const char* hex = "0123456789abcdef";
+        const char* p = m;
+
+        for (; *p; ++p)
         {
-                char buf[128];
-                snprintf(buf, 
-                         128, 
-                         "Only %d signals can be catched\n",
-                         MAX_SIG);
-                exit(1);      
+                unsigned char c = (unsigned char)*p;
+                char esc[6] = {'\\', 'u', '0', '0', 0, 0};
+
+                if (c >= 0x20 && c != '"' && c != '\\')
+                {
+                        continue;
+                }
+                say_n(m, p - m);
+                m = p + 1;
+                switch (c)
+                {
+                case '"':
+                        say("\\\"");
+                        break;
+                case '\\':
+                        say("\\\\");
+                        break;
+                case '\n':
+                        say("\\n");
+                        break;
+                case '\t':
+                        say("\\t");
+                        break;
+                default:
+                        esc[4] = hex[c >> 4];
+                        esc[5] = hex[c & 0xf];
+                        say_n(esc, sizeof(esc));
+                }
         }
-        suite->sig_expected[suite->exp_sig_pos++] = signum;
+        say_n(m, p - m);
 }
 
-int scut_assert_sig(int signum)
+static void say_xml(const char* m)
 {
-        for (int i = 0; i < suite->catch_sig_pos; ++i)
+        const char* p = m;
+
+        for (; *p; ++p)
         {
-                if (signum == suite->sig_catched[i])
+                const char* esc;
+                unsigned char c = (unsigned char)*p;
+
+                switch (c)
                 {
-                        return 1;
+                case '<':
+                        esc = "&lt;";
+                        break;
+                case '>':
+                        esc = "&gt;";
+                        break;
+                case '&':
+                        esc = "&amp;";
+                        break;
+                case '"':
+                        esc = "&quot;";
+                        break;
+                default:
+                        /* Not allowed in XML 1.0 at all */
+                        esc = c < 0x20 && c != '\n' && c != '\t' && c != '\r' ? 
+                                "" : NULL;
+                }
+                if (esc)
+                {
+                        say_n(m, p - m);
+                        say(esc);
+                        m = p + 1;
                 }
         }
-
-        return 0;
+        say_n(m, p - m);
 }
 
-int scut_num_tests(void)
+/* Say each line of m with a prefix */
+static void say_lines(const char* m, const char* prefix)
 {
-        return suite->count;
+        while (*m)
+        {
+                const char* nl = strchr(m, '\n');
+                size_t len = nl ? (size_t)(nl - m) + 1 : strlen(m);
+
+                say(prefix);
+                say_n(m, len);
+                m += len;
+        }
+        if (m[-1] != '\n')
+        {
+                say("\n");
+        }
 }
 
-void scut_destroy(void)
+/* Write to the real stdout, whole, whichever run is capturing fd 1 */
+static void write_out(const char* m, size_t len)
 {
-        free(suite->tests);
-        free(suite);
-        suite = NULL;
+        pthread_mutex_lock(&out_lock);
+        write_all(captures ? real_out : 1, m, len);
+        pthread_mutex_unlock(&out_lock);
 }
 
-static void prepare_test(void)
+/*
+ * Write out buffered report output. Unless all is set, a trailing
+ * partial line is kept back so that lines from concurrent runs do not
+ * get mixed up.
+ */
+static void flush(int all)
 {
-        suite->catch_sig_pos = 0;
-        suite->exp_sig_pos = 0;
+        size_t len = cur->olen;
 
-        for( int i = 0; i < MAX_SIG; ++i)
+        /* A forked test must not repeat what its parent has buffered */
+        if (cur->opid != getpid())
         {
-                suite->sig_catched[i] = -1;
-                suite->sig_expected[i] = -1;
+                cur->olen = 0;
+                return;
         }
 
-        sig_setup();
+        while (!all && len > 0 && cur->obuf[len - 1] != '\n')
+        {
+                len--;
+        }
+        if (len == 0)
+        {
+                len = cur->olen;
+        }
+        if (len > 0)
+        {
+                write_out(cur->obuf, len);
+        }
+        memmove(cur->obuf, cur->obuf + len, cur->olen - len);
+        cur->olen -= len;
 }
 
-static void say(const char* m)
+static void flush_at_exit_setup(void)
 {
-        write(out, m, strlen(m));
+        atexit(&flush_at_exit);
 }
 
+static void flush_at_exit(void)
+{
+        for (struct scut_run* r = cur; r; r = r->prev)
+        {
+                cur = r;
+                flush(1);
+        }
+}
+
+/*
+ * Collect the output of the last test and rewind the capture file.
+ * Returns NULL if nothing was printed.
+ */
 static char* drain(int fd)
 {
-        ssize_t len = 1024 * 1024; // Start with 1MiB
-        ssize_t br;
-        char* msg = malloc(len);
+        struct stat st;
+        size_t len;
+        size_t pos;
+        char* msg;
+
+        /* Most tests print nothing, so check the offset before the stat. */
+        if (fd < 0 || lseek(fd, 0, SEEK_CUR) <= 0 || fstat(fd, &st) ||
+            st.st_size <= 0)
+        {
+                return NULL;
+        }
+
+        if (st.st_size <= CAPTURE_HEAD + CAPTURE_TAIL)
+        {
+                len = (size_t)st.st_size;
+                msg = malloc(len + 1);
+                if (msg && pread_all(fd, msg, len, 0))
+                {
+                        len = 0;
+                }
+        }
+        else
+        {
+                msg = malloc(CAPTURE_HEAD + MAX_MSG + CAPTURE_TAIL + 1);
+                len = 0;
+                if (msg && pread_all(fd, msg, CAPTURE_HEAD, 0) == 0)
+                {
+                        pos = CAPTURE_HEAD;
+                        pos += snprintf(msg + pos, 
+                                        MAX_MSG, 
+                                        "\n>>> %lld bytes omitted <<<\n",
+                                        (long long)st.st_size - 
+                                        CAPTURE_HEAD - CAPTURE_TAIL);
+                        if (pread_all(fd, 
+                                      msg + pos, 
+                                      CAPTURE_TAIL, 
+                                      st.st_size - CAPTURE_TAIL) == 0)
+                        {
+                                len = pos + CAPTURE_TAIL;
+                        }
+                }
+        }
 
-        br = read(fd, msg, len);
-        
-        if (br == len)
+        if (ftruncate(fd, 0) == 0)
         {
-                br = len - 1;
+                lseek(fd, 0, SEEK_SET);
         }
-        if (br < 0)
+        if (msg)
         {
-                br = 0;
+                msg[len] = 0;
         }
 
-        msg[br] = 0;
         return msg;
 }
 
+static int pread_all(int fd, char* buf, size_t len, off_t off)
+{
+        while (len > 0)
+        {
+                ssize_t n = pread(fd, buf, len, off);
+
+                if (n < 0 && errno == EINTR)
+                {
+                        continue;
+                }
+                if (n <= 0)
+                {
+                        return 1;
+                }
+                buf += n;
+                off += n;
+                len -= n;
+        }
+
+        return 0;
+}
+
+/*
+ * Signals sent to the process, rather than raised by the faulting code,
+ * are blocked in threads of a run while no test is running there, and
+ * unblocked in tests. The kernel then delivers them to the thread running
+ * the test. Signals that hit some other thread are passed on by sig_trap,
+ * but arrive late. SIGCHLD is left alone, a parallel run ignores it.
+ */
+static const int idle_sigs[] = {
+        SIGALRM,
+        SIGCONT,
+        SIGHUP,
+        SIGPIPE,
+        SIGQUIT,
+        SIGTSTP,
+        SIGTTIN,
+        SIGTTOU,
+        SIGUSR1,
+        SIGUSR2,
+#if (!defined __FreeBSD__)
+        SIGPOLL,
+#endif
+        SIGPROF,
+        SIGURG,
+        SIGVTALRM,
+        SIGXCPU,
+        SIGXFSZ
+};
+
+static void idle_signals(sigset_t* set)
+{
+        sigemptyset(set);
+        for (size_t i = 0; i < sizeof(idle_sigs) / sizeof(int); ++i)
+        {
+                sigaddset(set, idle_sigs[i]);
+        }
+}
+
+static void unblock_idle(sigset_t* set)
+{
+        for (size_t i = 0; i < sizeof(idle_sigs) / sizeof(int); ++i)
+        {
+                sigdelset(set, idle_sigs[i]);
+        }
+}
+
 static int sig_setup(void)
 {
         int signals[] = {
@@ -375,34 +6989,70 @@ static int sig_setup(void)
         return 0;
 }
 
-static void sig_trap(int signum)
+/*
+ * Returning from these runs the faulting instruction again, so they are
+ * never passed on and returned from.
+ */
+static int sig_fault(int signum)
 {
-        int exp = 0;
+        return signum == SIGSEGV || signum == SIGBUS || 
+                signum == SIGFPE || signum == SIGILL;
+}
 
-        for (int i = 0; i < suite->exp_sig_pos; ++i)
+static void sig_trap(int signum)
+{
+        if (stress_self && sig_fault(signum))
+        {
+                stress_self->sig = signum;
+                siglongjmp(stress_self->env, 1);
+        }
+        if (cur == NULL || !cur->in_test)
         {
-                if (signum == suite->sig_expected[i])
+                struct scut_run* run = test_run;
+                int other = test_running && 
+                        !pthread_equal(test_thread, pthread_self());
+
+                if (sig_fault(signum) && (!other || run == NULL || run->worker))
                 {
-                        exp = 1;
-                        break;
+                        /* Crash, a worker is reported by its parent */
+                        signal(signum, SIG_DFL);
+                        return;
+                }
+                /* Process directed signals go to the thread running a test */
+                if (other)
+                {
+                        pthread_kill(test_thread, signum);
+                }
+                if (sig_fault(signum))
+                {
+                        /* 
+                         * The test fails with the signal, this thread of it
+                         * waits forever with all signals blocked.
+                         */
+                        for (;;)
+                        {
+                                pause();
+                        }
                 }
+                return;
+        }
+        if (signum == SIGCHLD && parallel_runs)
+        {
+                /* A worker of a parallel run exited */
+                return;
         }
 
-        if (exp)
+        if (signum == SIGALRM && cur->deadline && now_ns() >= cur->deadline)
         {
-                if (suite->catch_sig_pos >= MAX_SIG)
-                {
-                        char buf[128];
-                        snprintf(buf, 
-                                 128, 
-                                 "Maximum (%d) number of signals received, giving up\n",
-                                 MAX_SIG);
-                        exit(1);
-                }
-                suite->sig_catched[suite->catch_sig_pos++] = signum;
+                longjmp(cur->env, JMP_TIMEOUT);
+        }
+
+        if (sigismember(&cur->sig_expected, signum) == 1)
+        {
+                sigaddset(&cur->sig_caught, signum);
         }
         else 
         {
-                longjmp(suite->env, signum);
+                longjmp(cur->env, signum);
         }
 }
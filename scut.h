@@ -17,6 +17,61 @@
 #include <stdio.h>
 
 #define SCUT_ADD(m) scut_add(&m, #m)
+#define SCUT_ADD_TIMEOUT(m, ms) scut_add_timeout(&m, #m, (ms))
+#define SCUT_ADD_BENCH(m) scut_add_bench(&m, #m)
+#define SCUT_ADD_PARAM(m, t, n) scut_add_param(&m, #m, (t), sizeof(*(t)), (n))
+#define SCUT_ADD_PROP(m) scut_add_prop(&m, #m, 0, 0)
+/* Define a suite fixture, see scut_use */
+#define SCUT_FIXTURE(n, setup, teardown)                                \
+        static const struct scut_fixture n = {(setup), (teardown), #n}
+#define SCUT_USE(f) scut_use(&f)
+/* Fail the last added test if it got slower, see scut_no_regression */
+#define SCUT_ASSERT_NO_REGRESSION(t) scut_no_regression((t))
+#define SCUT_ADD_ALL() scut_add_all()
+/*
+ * Define a test which registers itself when the program is loaded. This
+ * needs constructors, a GCC and Clang extension. With other compilers
+ * the macro only defines the test, which must then be added with
+ * SCUT_ADD (or SCUT_ADD_BENCH for SCUT_BENCH) instead of SCUT_ADD_ALL.
+ */
+#if defined(__GNUC__)
+#define SCUT_TEST(n)                                                    \
+        static int n(void);                                             \
+        static struct scut_auto scut_auto_##n = {&n, NULL, #n, NULL};   \
+        static void __attribute__((constructor)) scut_reg_##n(void)     \
+        {                                                               \
+                scut_register(&scut_auto_##n);                          \
+        }                                                               \
+        static int n(void)
+#else
+#define SCUT_TEST(n) static int n(void)
+#endif
+/* 
+ * Define a benchmark which registers itself. The body has access to
+ * struct scut_bench* bench, and shall run the measured code bench->n
+ * times, e.g. with SCUT_BENCH_LOOP.
+ */
+#if defined(__GNUC__)
+#define SCUT_BENCH(n)                                                   \
+        static int n(struct scut_bench*);                               \
+        static struct scut_auto scut_auto_##n = {NULL, &n, #n, NULL};   \
+        static void __attribute__((constructor)) scut_reg_##n(void)     \
+        {                                                               \
+                scut_register(&scut_auto_##n);                          \
+        }                                                               \
+        static int n(struct scut_bench* bench)
+#else
+#define SCUT_BENCH(n) static int n(struct scut_bench* bench)
+#endif
+#define SCUT_BENCH_LOOP                                                 \
+        for (unsigned long long scut_i = 0; scut_i < bench->n; ++scut_i)
+#define SCUT_BENCH_BYTES(b) (bench->bytes = (b))
+/* Keep the compiler from optimizing away a computed value */
+#if defined(__GNUC__)
+#define SCUT_DO_NOT_OPTIMIZE(x) __asm__ __volatile__("" : : "r,m"(x) : "memory")
+#else
+#define SCUT_DO_NOT_OPTIMIZE(x) scut_do_not_optimize(&(x))
+#endif
 #define SCUT_FAIL(msg) do {printf("%s: %s+%d\n", msg, __FILE__, __LINE__); return 1;} while(0)
 #define SCUT_ASSERT_IE(a, b) do {if((long)(a) != (long)(b)) {           \
                         printf("Assertion error, found %ld, expected %ld: %s+%d\n", (long)(a), (long)(b), __FILE__, __LINE__); \
@@ -25,19 +80,136 @@
                         printf("Assertion failed, expected true: %s+%d\n", __FILE__, __LINE__);return 1;}} while(0)
 #define SCUT_ASSERT_FALSE(a) do {if((a)){                               \
                         printf("Assertion failed, expected false: %s+%d\n", __FILE__, __LINE__);return 1;}} while(0)
+#define SCUT_ASSERT_MEM_EQ(a, b, n) do {if(!scut_mem_eq((a), (b), (n), 1, __FILE__, __LINE__)) return 1;} while(0)
+#define SCUT_ASSERT_ARRAY_EQ(a, b, n) do {if(!scut_mem_eq((a), (b), (n) * sizeof(*(a)), sizeof(*(a)), __FILE__, __LINE__)) return 1;} while(0)
+/*
+ * Compare floating point values within a tolerance: absolute, relative
+ * to the larger magnitude, or in units in the last place. The scalar
+ * forms measure ULPs in float when a is a float, the array forms take
+ * the precision from the element type of a.
+ */
+#define SCUT_ASSERT_NEAR(a, b, t) do {if(!scut_near((a), (b), sizeof(a) == sizeof(float), SCUT_TOL_ABS, (t), __FILE__, __LINE__)) return 1;} while(0)
+#define SCUT_ASSERT_REL(a, b, t) do {if(!scut_near((a), (b), sizeof(a) == sizeof(float), SCUT_TOL_REL, (t), __FILE__, __LINE__)) return 1;} while(0)
+#define SCUT_ASSERT_ULP(a, b, t) do {if(!scut_near((a), (b), sizeof(a) == sizeof(float), SCUT_TOL_ULP, (t), __FILE__, __LINE__)) return 1;} while(0)
+#define SCUT_ASSERT_ARRAY_NEAR(a, b, n, t) do {if(!scut_float_eq((a), (b), (n), sizeof(*(a)), SCUT_TOL_ABS, (t), __FILE__, __LINE__)) return 1;} while(0)
+#define SCUT_ASSERT_ARRAY_REL(a, b, n, t) do {if(!scut_float_eq((a), (b), (n), sizeof(*(a)), SCUT_TOL_REL, (t), __FILE__, __LINE__)) return 1;} while(0)
+#define SCUT_ASSERT_ARRAY_ULP(a, b, n, t) do {if(!scut_float_eq((a), (b), (n), sizeof(*(a)), SCUT_TOL_ULP, (t), __FILE__, __LINE__)) return 1;} while(0)
+/*
+ * Non-fatal forms of the assertions. A failed expectation is recorded
+ * and the test continues, but fails when it returns. A passing one costs
+ * a compare, except _REL and _ULP of values that differ.
+ */
+#define SCUT_EXPECT_IE(a, b) do {long scut_x = (long)(a); long scut_y = (long)(b); \
+                if(scut_x != scut_y) scut_expect_ie(scut_x, scut_y, #a " == " #b, __FILE__, __LINE__);} while(0)
+#define SCUT_EXPECT_TRUE(a) do {if(!(a)) scut_expect_bool(1, #a, __FILE__, __LINE__);} while(0)
+#define SCUT_EXPECT_FALSE(a) do {if((a)) scut_expect_bool(0, #a, __FILE__, __LINE__);} while(0)
+#define SCUT_EXPECT_NEAR(a, b, t) do {double scut_x = (a); double scut_y = (b); double scut_t = (t); \
+                if(!(scut_x - scut_y <= scut_t && scut_y - scut_x <= scut_t)) \
+                        scut_expect_near(scut_x, scut_y, sizeof(a) == sizeof(float), SCUT_TOL_ABS, scut_t, #a " == " #b, __FILE__, __LINE__);} while(0)
+#define SCUT_EXPECT_REL(a, b, t) do {double scut_x = (a); double scut_y = (b); \
+                if(scut_x != scut_y) scut_expect_near(scut_x, scut_y, sizeof(a) == sizeof(float), SCUT_TOL_REL, (t), #a " == " #b, __FILE__, __LINE__);} while(0)
+#define SCUT_EXPECT_ULP(a, b, t) do {double scut_x = (a); double scut_y = (b); \
+                if(scut_x != scut_y) scut_expect_near(scut_x, scut_y, sizeof(a) == sizeof(float), SCUT_TOL_ULP, (t), #a " == " #b, __FILE__, __LINE__);} while(0)
 #define SCUT_EXPECT_SIG(s) scut_expect_sig((s))
+/*
+ * Call int fn(int thread, long long iteration) iterations times in each
+ * of n threads, started together, see scut_stress. Assertions in fn
+ * stop its thread, expectations in any thread are recorded.
+ */
+#define SCUT_STRESS(n, iterations, fn) do {if(scut_stress((n), (iterations), &(fn), __FILE__, __LINE__)) return 1;} while(0)
 #define SCUT_ASSERT_SIG(s) do {if(!scut_assert_sig((s))){               \
                         printf("Assertion error, signal %d was not caught: %s+%d\n", (s), __FILE__, __LINE__); return 1;}} while(0)
+/*
+ * Check the heap allocations made by the statement or block that
+ * follows, e.g. SCUT_ASSERT_MAX_ALLOCS(2) { ... }. Leaving the block
+ * with break or return skips the check.
+ */
+#define SCUT_ASSERT_MAX_ALLOCS(n)                                       \
+        for (long long scut_a = scut_alloc_begin();                     \
+             scut_a != -1;                                              \
+             scut_a = scut_alloc_end(scut_a, (n), __FILE__, __LINE__))  \
+                if (scut_a == -2) return 1; else
+#define SCUT_ASSERT_NO_ALLOC SCUT_ASSERT_MAX_ALLOCS(0)
+/*
+ * Check the count of a performance counter over the statement or block
+ * that follows, e.g. SCUT_ASSERT_MAX_CACHE_MISSES(100) { ... }. The
+ * check passes if the counter is unavailable.
+ */
+#define SCUT_ASSERT_MAX_EVENTS(e, n)                                    \
+        for (long long scut_p = scut_perf_begin((e));                   \
+             scut_p != -1;                                              \
+             scut_p = scut_perf_end((e), scut_p, (n), __FILE__, __LINE__)) \
+                if (scut_p == -2) return 1; else
+#define SCUT_ASSERT_MAX_INSTRUCTIONS(n)                                 \
+        SCUT_ASSERT_MAX_EVENTS(SCUT_PERF_INSTRUCTIONS, (n))
+#define SCUT_ASSERT_MAX_CACHE_MISSES(n)                                 \
+        SCUT_ASSERT_MAX_EVENTS(SCUT_PERF_CACHE_MISSES, (n))
+#define SCUT_ASSERT_MAX_BRANCH_MISSES(n)                                \
+        SCUT_ASSERT_MAX_EVENTS(SCUT_PERF_BRANCH_MISSES, (n))
+
+struct scut_bench
+{
+        /* Number of iterations to run */
+        unsigned long long n;
+        /* Bytes processed per iteration, optional */
+        unsigned long long bytes;
+};
+
+/* State of a property test, passed to the generators */
+struct scut_prop;
+
+/* A fixture shared by the tests of a suite, see scut_use */
+struct scut_fixture
+{
+        /* Build the fixture, store it in *data and return 0 on success */
+        int (*setup)(void** data);
+        /* Tear it down, may be NULL */
+        void (*teardown)(void* data);
+        const char* name;
+};
+
+struct scut_auto
+{
+        int (*test)(void);
+        int (*bench)(struct scut_bench*);
+        const char* name;
+        struct scut_auto* next;
+};
 
 #define SCUT_VERBOSE 0x1
+#define SCUT_PARALLEL 0x2
+#define SCUT_STATS 0x4
+#define SCUT_TAP 0x8
+#define SCUT_JUNIT 0x10
+#define SCUT_JSONL 0x20
+#define SCUT_ALLOCS 0x40
+#define SCUT_PERF 0x80
+
+/* Performance counters, see SCUT_PERF */
+#define SCUT_PERF_INSTRUCTIONS 0
+#define SCUT_PERF_CYCLES 1
+#define SCUT_PERF_CACHE_MISSES 2
+#define SCUT_PERF_BRANCH_MISSES 3
+#define SCUT_PERF_TLB_MISSES 4
+#define SCUT_PERF_TASK_CLOCK 5
+#define SCUT_PERF_PAGE_FAULTS 6
+#define SCUT_PERF_CONTEXT_SWITCHES 7
+
+/* Floating point tolerances, see scut_float_eq */
+#define SCUT_TOL_ABS 0
+#define SCUT_TOL_REL 1
+#define SCUT_TOL_ULP 2
 #define UNIT_TEST
 
+/* A test suite handle, see scut_suite_new */
+typedef struct scut_suite scut_suite_t;
+
 /**
  * Creates a test suite. Tests can then be added to the suite for
  * execution. The suite is created as a static global object. Only
  * on suite can exist at a given time. Multiple calls to scut_create
  * will destroy any earlier created, and only the last created will 
- * we active.
+ * we active. Use scut_suite_new for more than one suite.
  * @param The name of the suite.
  * @return void
  */
@@ -55,10 +227,377 @@ void scut_create(const char*);
 int scut_add(int (*test)(void), 
              const char*);
 
+/**
+ * Add a benchmark to the suite. The benchmark is called repeatedly, first
+ * to calibrate the number of iterations (which also warms it up), and then
+ * to measure for a fixed time (SCUT_BENCH_TIME in milliseconds, default
+ * 250). The result is reported as ns/op, op/s, MB/s if bytes per
+ * iteration is set, and p50/p90/p99/max ns/op over the measured batches.
+ * A benchmark fails like a test, by returning non zero.
+ * @param the benchmark to run. It shall run the code being measured
+ *        bench->n times and return 0 on success.
+ * @param The name of the benchmark, this must be a null terminated string.
+ * @return 0 if the benchmark was successfully added.
+ */
+int scut_add_bench(int (*bench)(struct scut_bench*),
+                   const char*);
+
+/**
+ * Add a parameterized test, run once for each case in a table. Every
+ * case is a test of its own named name[index], which is filtered,
+ * sharded and handed to parallel workers separately. The table is not
+ * copied, and must stay valid until the suite is destroyed.
+ * SCUT_ADD_PARAM(test, table, n) passes the element size of the table.
+ * @param the test to run, called with a pointer to one case. It shall
+ *        return 0 on success, and non zero upon failure.
+ * @param The name of the test, this must be a null terminated string.
+ * @param The table of cases.
+ * @param The size of one case in bytes.
+ * @param The number of cases.
+ * @return 0 if the test was successfully added.
+ */
+int scut_add_param(int (*test)(const void*),
+                   const char*,
+                   const void*,
+                   size_t,
+                   int);
+
+/**
+ * Add a property test. The property draws its input from the scut_gen_*
+ * functions and fails like a test, and is called with new input until
+ * it fails or the cases or time run out. A failing input is shrunk to
+ * a minimal counterexample by trying simpler input, and its seed is
+ * printed. Running with SCUT_SEED=seed tries that case first. A signal
+ * fails a case, not the whole test. Searches of 10000 cases or more, or
+ * with a time limit, are spread over one forked process per online CPU
+ * (SCUT_PROP_JOBS=N overrides) unless the test runs in a parallel
+ * worker, and a property run that way must not depend on state changed
+ * by earlier cases. Only the output of the last case is kept.
+ * SCUT_ADD_PROP(prop) uses the defaults, SCUT_PROP_CASES or
+ * SCUT_PROP_TIME (milliseconds) if set, else 1000 cases.
+ * @param the property, returning 0 if it holds for the generated input.
+ * @param The name of the test, this must be a null terminated string.
+ * @param The number of cases to try, 0 for no limit if a time is given.
+ * @param Time to search in milliseconds, 0 for no limit.
+ * @return 0 if the test was successfully added.
+ */
+int scut_add_prop(int (*prop)(struct scut_prop*),
+                  const char*,
+                  int,
+                  int);
+
+/**
+ * Generate an integer in [min, max], shrinking towards 0 (or the bound
+ * closest to 0).
+ * @param the property state.
+ * @param Smallest value.
+ * @param Largest value.
+ * @return the value.
+ */
+long long scut_gen_int(struct scut_prop*, long long, long long);
+
+/**
+ * Generate a double in [min, max), shrinking towards 0 (or the bound
+ * closest to 0).
+ * @param the property state.
+ * @param Smallest value.
+ * @param Largest value.
+ * @return the value.
+ */
+double scut_gen_double(struct scut_prop*, double, double);
+
+/**
+ * Fill a buffer with up to max random bytes, shrinking towards fewer
+ * bytes that are 0.
+ * @param the property state.
+ * @param The buffer.
+ * @param Size of the buffer.
+ * @return the number of bytes generated.
+ */
+size_t scut_gen_bytes(struct scut_prop*, void*, size_t);
+
+/**
+ * Generate a null terminated string of printable ASCII characters,
+ * shrinking towards fewer characters that are 'a'.
+ * @param the property state.
+ * @param The buffer.
+ * @param Size of the buffer, including the terminator.
+ * @return the length of the string.
+ */
+size_t scut_gen_string(struct scut_prop*, char*, size_t);
+
+/**
+ * Opaque sink for SCUT_DO_NOT_OPTIMIZE on compilers without inline asm.
+ * @param pointer to the value to keep.
+ * @return void
+ */
+void scut_do_not_optimize(const void*);
+
+/**
+ * Compare two buffers, used by SCUT_ASSERT_MEM_EQ and
+ * SCUT_ASSERT_ARRAY_EQ. Equal stretches are compared with memcmp(3),
+ * so large buffers are compared at close to memory bandwidth. On a
+ * mismatch the first differing offset (and element), the number of
+ * differing bytes and a hex dump of up to 48 bytes around the first
+ * difference are printed.
+ * @param the buffer found.
+ * @param the buffer expected.
+ * @param the size of the buffers in bytes.
+ * @param the size of an element, 1 for bytes.
+ * @param file and line to report.
+ * @return 1 if the buffers are equal, 0 if not.
+ */
+int scut_mem_eq(const void*, const void*, size_t, size_t, const char*, int);
+
+/**
+ * Compare two arrays of float or double within a tolerance, used by
+ * SCUT_ASSERT_ARRAY_NEAR, _REL and _ULP. Two NaNs are equal, a NaN
+ * and a number are not. The arrays are first checked by a branch free
+ * loop, and only on a failure is each element looked at again to
+ * report the worst element and how the errors are distributed.
+ * @param the array found.
+ * @param the array expected.
+ * @param the number of elements.
+ * @param the size of an element, sizeof(float) or sizeof(double).
+ * @param SCUT_TOL_ABS, SCUT_TOL_REL or SCUT_TOL_ULP.
+ * @param the largest error allowed.
+ * @param file and line to report.
+ * @return 1 if all elements are within the tolerance, 0 if not.
+ */
+int scut_float_eq(const void*, 
+                  const void*, 
+                  size_t, 
+                  size_t, 
+                  int, 
+                  double, 
+                  const char*, 
+                  int);
+
+/**
+ * Compare two floating point values within a tolerance, used by
+ * SCUT_ASSERT_NEAR, _REL and _ULP.
+ * @param the value found.
+ * @param the value expected.
+ * @param 1 to compare as float, 0 as double.
+ * @param SCUT_TOL_ABS, SCUT_TOL_REL or SCUT_TOL_ULP.
+ * @param the largest error allowed.
+ * @param file and line to report.
+ * @return 1 if the values are within the tolerance, 0 if not.
+ */
+int scut_near(double, double, int, int, double, const char*, int);
+
+/**
+ * Record a failed SCUT_EXPECT_IE. Failures are kept as values, and only
+ * formatted when the test is reported. The first 32 of a test are kept,
+ * the rest only counted. Expectations may fail in any thread, and are
+ * recorded with the test that is running. Outside a running test the
+ * failure is printed right away.
+ * @param the value found.
+ * @param the value expected.
+ * @param the expression, file and line to report.
+ */
+void scut_expect_ie(long long, long long, const char*, const char*, int);
+
+/**
+ * Record a failed SCUT_EXPECT_TRUE or SCUT_EXPECT_FALSE.
+ * @param the value expected, 1 for true.
+ * @param the expression, file and line to report.
+ */
+void scut_expect_bool(int, const char*, const char*, int);
+
+/**
+ * Check SCUT_EXPECT_NEAR, _REL and _ULP as scut_near does, and record
+ * a failure.
+ * @param the value found.
+ * @param the value expected.
+ * @param 1 to compare as float, 0 as double.
+ * @param SCUT_TOL_ABS, SCUT_TOL_REL or SCUT_TOL_ULP.
+ * @param the largest error allowed.
+ * @param the expression, file and line to report.
+ */
+void scut_expect_near(double, 
+                      double, 
+                      int, 
+                      int, 
+                      double, 
+                      const char*, 
+                      const char*, 
+                      int);
+
+/**
+ * Load test code under test from several threads, used by SCUT_STRESS.
+ * The threads wait at a gate until all are started, then each calls
+ * the function with its number and iterations 0 to iterations - 1,
+ * stopping at the first call that returns non-zero, or that crashes
+ * with SIGSEGV, SIGBUS, SIGFPE or SIGILL. A crash only ends its own
+ * thread, which counts as failed, and all threads are joined before
+ * returning. When the test times out the threads stop before their next
+ * call and are joined, then the test ends as timed out; a call that
+ * never returns holds that up. Each thread keeps its own result, so
+ * nothing is shared while they run. The iterations done per second over
+ * all threads are reported with the test, for the last stress run of a
+ * test.
+ * @param the number of threads.
+ * @param the iterations per thread.
+ * @param the function, called with the thread and iteration number.
+ * @param file and line to report.
+ * @return 0 if all threads completed, 1 if not.
+ */
+int scut_stress(int, long long, int (*)(int, long long), const char*, int);
+
+/**
+ * Start counting heap allocations of the calling thread, used by
+ * SCUT_ASSERT_MAX_ALLOCS. Allocations are only seen where scut is
+ * built with SCUT_ALLOC_HOOKS and can interpose the allocator (glibc),
+ * elsewhere none are counted and the assertions always hold.
+ * @return the number of allocations so far.
+ */
+long long scut_alloc_begin(void);
+
+/**
+ * Stop counting, and report an error if more than max allocations
+ * were made since scut_alloc_begin.
+ * @param the value returned by scut_alloc_begin.
+ * @param the allowed number of allocations.
+ * @param file and line to report.
+ * @return -1 if the budget held, -2 if not.
+ */
+long long scut_alloc_end(long long, long long, const char*, int);
+
+/**
+ * Read a performance counter of the calling thread while a test runs,
+ * used by SCUT_ASSERT_MAX_EVENTS.
+ * @param the counter, e.g. SCUT_PERF_CACHE_MISSES.
+ * @return the count so far, 0 if the counter is unavailable.
+ */
+long long scut_perf_begin(int);
+
+/**
+ * Report an error if a counter went up by more than max since
+ * scut_perf_begin. An unavailable counter is never in error.
+ * @param the counter.
+ * @param the value returned by scut_perf_begin.
+ * @param the allowed count.
+ * @param file and line to report.
+ * @return -1 if the budget held, -2 if not.
+ */
+long long scut_perf_end(int, long long, long long, const char*, int);
+
+/**
+ * Add all tests and benchmarks defined with SCUT_TEST and SCUT_BENCH to
+ * the suite, in the order they were registered (for a single file, the
+ * order they are defined in). Without GCC or Clang nothing registers
+ * itself, and this adds nothing.
+ * @return 0 if the tests were successfully added.
+ */
+int scut_add_all(void);
+
+/**
+ * Register a test for scut_add_all. Called by the constructor generated
+ * by SCUT_TEST before main runs, and does not allocate any memory.
+ * @param the test to register, must outlive the program.
+ * @return void
+ */
+void scut_register(struct scut_auto*);
+
+/**
+ * Add a single test with its own timeout, overriding the suite default.
+ * @param the test to run, see scut_add.
+ * @param The name of the test, this must be a null terminated string.
+ * @param Timeout in milliseconds, 0 to use the suite default.
+ * @return 0 if the test was successfully added.
+ */
+int scut_add_timeout(int (*test)(void), 
+                     const char*,
+                     int);
+
+/**
+ * Set the default timeout for all tests in the suite. A test running past
+ * its timeout is interrupted and reported as TIMED OUT, and the run carries
+ * on with the next test. If no timeout is set, the environment variable
+ * SCUT_TIMEOUT (milliseconds), read when the run starts, is used. The
+ * watchdog uses ITIMER_REAL, so tests relying on alarm(2) should not be
+ * given a timeout.
+ * @param Timeout in milliseconds, 0 disables the timeout.
+ * @return void
+ */
+void scut_timeout(int);
+
+/**
+ * Set functions called before and after every test, either may be NULL.
+ * They are part of the test: failing or crashing in them fails the
+ * test. The teardown runs after the test, also if it failed or crashed,
+ * unless the setup failed or the test timed out.
+ * @param the setup, returning 0 on success.
+ * @param the teardown, returning 0 on success.
+ * @return void
+ */
+void scut_setup(int (*setup)(void), int (*teardown)(void));
+
+/**
+ * Declare that the last added test uses a suite fixture, may be called
+ * more than once per test. A fixture is built the first time a test
+ * using it runs, shared by all tests of the run, and torn down when
+ * the run ends. If it fails to build, the tests using it fail. In a
+ * parallel run the fixtures of all selected tests are built before
+ * the workers are forked, and shared with them copy-on-write.
+ * SCUT_USE(fixture) is the same as scut_use(&fixture).
+ * @param the fixture, which must outlive the suite.
+ * @return 0 on success.
+ */
+int scut_use(const struct scut_fixture*);
+
+/**
+ * Get the data of a suite fixture while a test runs, building it if no
+ * test used it before. Fixtures not declared with scut_use are built
+ * in each parallel worker, and only torn down in serial runs.
+ * @param the fixture.
+ * @return the data stored by the fixture setup, NULL if it failed.
+ */
+void* scut_fixture(const struct scut_fixture*);
+
 /**
  * Executes the tests in the provided suite.
  * Any output from a test will be captured, and not displayed unless the test
  * fails (this can be changed via flags).
+ * With SCUT_PARALLEL the tests are spread over one forked worker per online
+ * CPU. The number of workers can also be set with the environment variable
+ * SCUT_JOBS=N, which enables parallel execution on its own. Results are
+ * always reported in the order the tests were added, and a worker that
+ * crashes only fails the test it was running.
+ * With SCUT_STATS every test reports wall time, user and system CPU time,
+ * growth of the max RSS, minor/major page faults, voluntary/involuntary
+ * context switches and bytes read/written, and the summary lists the 5
+ * slowest tests. SCUT_SLOWEST=N sets the length of that list, and enables
+ * it without SCUT_STATS. A SCUT_JOBS, SCUT_SLOWEST or SCUT_TIMEOUT that is
+ * not a number of 0 or more fails the whole run.
+ * With SCUT_ALLOCS, or the environment variable SCUT_ALLOCS=1, heap
+ * allocations made while each test runs are counted, and every test
+ * reports its allocations, bytes allocated, peak live bytes and the
+ * blocks it did not free. Tracking costs nothing when it is off. Leaks
+ * are only reported, use SCUT_ASSERT_NO_ALLOC to enforce a budget.
+ * Counting replaces malloc, calloc, realloc, free, memalign,
+ * aligned_alloc and posix_memalign of the whole program, so it is only
+ * built in with SCUT_ALLOC_HOOKS defined (make ALLOC_HOOKS=1) and with
+ * glibc. Without it nothing is counted and the budgets always hold.
+ * With SCUT_PERF, or SCUT_PERF=1, every test also reports the Linux
+ * perf_event_open(2) counts of its body: instructions, cycles, cache
+ * misses, branch misses and data TLB misses in user space, as well as
+ * the task clock, page faults and context switches, which are software
+ * events and usually available where the hardware counters are not
+ * (e.g. in containers and virtual machines). Counters that can not be
+ * opened are reported as unavailable, and never fail a test.
+ * The report is human readable text by default. SCUT_TAP, SCUT_JUNIT and
+ * SCUT_JSONL select TAP version 13, JUnit XML or JSON Lines instead, as
+ * does the environment variable SCUT_REPORTER=tap|junit|jsonl.
+ * Only the tests selected by scut_filter and scut_shard are run and
+ * counted, the others are skipped without any setup.
+ * Signal handlers are installed once per run, and the setup of each test
+ * takes constant time. An in-process test without a timeout that prints
+ * nothing costs three system calls on top of the test itself: the signal
+ * mask is set before and after it, and the capture file is checked for
+ * output. That is roughly 1 to 1.5 microseconds per test, as measured by
+ * make bench.
  * @param On ore more flags, multiple flags can be "ored" (|) together.
  * @return The number of failed tests. 0 is returned if all tests were
  *         sucessfully executed.
@@ -66,21 +605,170 @@ int scut_add(int (*test)(void),
 int scut_run(int);
 
 /**
- * Announce that a signal is expected.
+ * Select tests by name. The filter is a comma separated list of glob
+ * patterns as in fnmatch(3), where patterns starting with '-' exclude
+ * tests, e.g. "parse_*,-parse_slow_*". A test is run if it matches no
+ * exclude pattern, and any of the include patterns if there are any.
+ * Without a filter the environment variable SCUT_FILTER is used.
+ * @param the filter, which is copied, or NULL to run all tests.
+ * @return 0 on success.
+ */
+int scut_filter(const char*);
+
+/**
+ * Run only a part of the suite, for splitting one test binary over
+ * several machines. Of the tests selected by the filter, shard index runs
+ * every total:th starting at number index, so the shards never overlap
+ * and together cover all tests as long as they use the same filter.
+ * With a history (see scut_history) the tests are split by expected
+ * time instead, which also never overlaps as long as the shards read the
+ * same history.
+ * Without a shard the environment variables SCUT_SHARD_INDEX and
+ * SCUT_SHARD_TOTAL are used, and a value that is not a number fails the
+ * whole run.
+ * @param the shard index, from 0 to total - 1.
+ * @param the number of shards, 0 to unset.
+ * @return 0 on success, 1 if the index is out of range.
+ */
+int scut_shard(int, int);
+
+/**
+ * Keep a history of test durations in a file. After each run the time
+ * of every test that ran is merged into the file, weighing the old time
+ * and the new equally, along with whether the test passed. Runs read it
+ * back to hand the longest tests to workers first, and to balance shards
+ * by expected time rather than by count. Tests without history are
+ * expected to take the average time.
+ * Shards only agree on which tests they run if they use the same history
+ * file, so a sharded run never writes it. Shard N writes the tests it ran
+ * to path.shard.N instead, and the next run without shards merges those
+ * files into the history and removes them.
+ * Without a file the environment variable SCUT_HISTORY is used. If
+ * neither is set no history is kept, unless the result cache or failed
+ * first is on: they need the last outcomes, and write .scut_history in
+ * the current directory. To keep no file, leave both of those off.
+ * @param path of the file, or NULL to keep no history.
+ * @return 0 on success.
+ */
+int scut_history(const char*);
+
+/**
+ * Run the tests that failed the last time first, in the order they were
+ * added, followed by the rest. The last outcome of each test is kept in
+ * the history file (see scut_history), which defaults to .scut_history
+ * in the current directory. Without a setting the environment variable
+ * SCUT_FAILED_FIRST=1 turns it on.
+ * @param 1 to run failed tests first, -1 to turn it off.
+ * @return void
+ */
+void scut_failed_first(int);
+
+/**
+ * Stop after a number of failed tests. The tests not run are skipped, and
+ * reported as such in the summary. Tests already running in parallel
+ * workers are allowed to finish and are reported. Without a setting the
+ * environment variable SCUT_FAIL_FAST=N is used, and a value that is not
+ * a number of 0 or more fails the whole run.
+ * @param the number of failures to stop after, 0 to run all tests.
+ * @return void
+ */
+void scut_fail_fast(int);
+
+/**
+ * Skip tests that passed the last time they ran in the very same
+ * executable. The executable is identified by its GNU build-id, or by a
+ * hash of its contents if it has none. Code in shared libraries is not
+ * part of the identity. Skipped tests are reported as CACHED, and not
+ * counted as performed. The outcomes are kept in the history file (see
+ * scut_history), which defaults to .scut_history. Without a setting the
+ * environment variable SCUT_CACHE=1 turns it on. Benchmarks always run.
+ * @param 1 to skip cached tests, 2 to run all tests but still update
+ *        the cache (as does SCUT_FORCE=1), -1 to turn it off.
+ * @return void
+ */
+void scut_cache(int);
+
+/**
+ * Run tests in processes forked from this one, which serves as a
+ * snapshot of the state after global initialization. A process runs at
+ * most n tests, and is replaced after any test that fails, so a crash
+ * or a corrupted heap never reaches later tests. With n = 1 every test
+ * starts from the snapshot, at the cost of a fork(2) rather than of a
+ * fresh start. Results and output come back over pipes as in a
+ * parallel run, and SCUT_JOBS still sets the number of processes.
+ * Suite fixtures are built before forking, and shared by all. Without
+ * a setting the environment variable SCUT_ISOLATE=N is used, and a
+ * value that is not a number of 0 or more fails the whole run.
+ * @param the number of tests per process, 0 to run in this process.
+ * @return void
+ */
+void scut_isolate(int);
+
+/**
+ * Compare test timings with a baseline file. A benchmark contributes
+ * one sample per batch, any other test one sample per run. Every passed
+ * test with a baseline is compared to it by a one sided Welch t-test,
+ * and reports the baseline and current mean time along with the
+ * confidence that it got slower by more than its tolerance. Tests are
+ * only failed for it if they have a tolerance, see scut_no_regression,
+ * and the confidence is at least 95%. Tests missing from the baseline
+ * are added to it. When saving, nothing is compared and the samples of
+ * the run are merged into the baseline instead, so saving several runs
+ * gives tests more than one sample. Remove the file to start over.
+ * Without a file the environment variables SCUT_BASELINE=FILE and
+ * SCUT_BASELINE_SAVE=1 are used.
+ * @param path of the file, or NULL to not compare.
+ * @param 1 to save the run to the baseline, 0 to compare with it.
+ * @return 0 on success.
+ */
+int scut_baseline(const char*, int);
+
+/**
+ * Fail the last added test when it is slower than its baseline by more
+ * than a fraction, e.g. 0.1 for 10%. Other tests use the environment
+ * variable SCUT_TOLERANCE if it is set. A test compared with a single
+ * sample on both sides can not be failed.
+ * SCUT_ASSERT_NO_REGRESSION(t) is the same as scut_no_regression(t).
+ * @param the allowed slowdown, at least 0.
+ * @return 0 on success.
+ */
+int scut_no_regression(double);
+
+/**
+ * Set options from the command line. Recognizes --filter=PATTERNS (or
+ * --filter PATTERNS), --shard=INDEX/TOTAL, --history=FILE,
+ * --failed-first, --fail-fast[=N], --cache, --force (a full run that
+ * updates the cache), --isolate[=N], --baseline=FILE and
+ * --save-baseline, any other argument is ignored. N must be a positive
+ * number.
+ * @param argc as passed to main.
+ * @param argv as passed to main.
+ * @return 0 on success, 1 if an option is malformed.
+ */
+int scut_args(int, char**);
+
+/**
+ * Announce that a signal is expected. Several signals may be expected, and
+ * expectations are cleared before the next test. The handlers are only
+ * installed when the run starts, so a test replacing one with sigaction(2)
+ * must restore it. Threads started by a test may expect signals for it,
+ * outside a test this does nothing.
  * @param the signal to expect.
  * @return void.
  */
 void scut_expect_sig(int);
 
 /**
- * Verify that a signal has been generated.
+ * Verify that a signal has been generated, from the test or a thread it
+ * started.
  * @param the signal to expect.
- * @return 1 if the signal was caught.
+ * @return 1 if the signal was caught, 0 if not or outside a test.
  */
 int scut_assert_sig(int);
 
 /**
- * Returns the number of stored tests in a suite.
+ * Returns the number of stored tests in a suite, each case of a
+ * parameterized test counts as one.
  * @return the number of tests stored in this suite.
  */
 int scut_num_tests(void);
@@ -91,4 +779,87 @@ int scut_num_tests(void);
  */
 void scut_destroy(void);
 
+/**
+ * Creates a test suite handle. Any number of suites can exist, and
+ * different suites can be built and run from different threads at the
+ * same time. A single suite must not be used by more than one thread at
+ * a time. The scut_suite_* functions work as their global counterparts
+ * above, which operate on the suite made by scut_create.
+ * Stdout and signal handlers are shared by the whole process, so tests
+ * that run in-process (without SCUT_PARALLEL or SCUT_JOBS) only run one
+ * at a time across all suites, while forked workers run concurrently.
+ * The reports of concurrent runs are interleaved line by line. Signals
+ * sent to the process, as with kill(2), are only delivered in time to
+ * the test expecting them if other threads, not running suites, block
+ * them. A crash (SIGSEGV, SIGBUS, SIGFPE or SIGILL) in a thread started
+ * by a test fails the test with that signal. In a forked worker the
+ * worker dies, otherwise the crashed thread is parked for good.
+ * @param The name of the suite.
+ * @return the new suite, or NULL if out of memory.
+ */
+scut_suite_t* scut_suite_new(const char*);
+
+/**
+ * Free a suite made by scut_suite_new.
+ * @param the suite, may be NULL.
+ * @return void.
+ */
+void scut_suite_free(scut_suite_t*);
+
+int scut_suite_add(scut_suite_t*, int (*test)(void), const char*);
+
+int scut_suite_add_timeout(scut_suite_t*, 
+                           int (*test)(void), 
+                           const char*, 
+                           int);
+
+int scut_suite_add_bench(scut_suite_t*, 
+                         int (*bench)(struct scut_bench*), 
+                         const char*);
+
+int scut_suite_add_param(scut_suite_t*, 
+                         int (*test)(const void*), 
+                         const char*,
+                         const void*,
+                         size_t,
+                         int);
+
+int scut_suite_add_prop(scut_suite_t*, 
+                        int (*prop)(struct scut_prop*), 
+                        const char*,
+                        int,
+                        int);
+
+int scut_suite_add_all(scut_suite_t*);
+
+void scut_suite_setup(scut_suite_t*, int (*setup)(void), int (*teardown)(void));
+
+int scut_suite_use(scut_suite_t*, const struct scut_fixture*);
+
+void scut_suite_timeout(scut_suite_t*, int);
+
+int scut_suite_filter(scut_suite_t*, const char*);
+
+int scut_suite_shard(scut_suite_t*, int, int);
+
+int scut_suite_history(scut_suite_t*, const char*);
+
+void scut_suite_failed_first(scut_suite_t*, int);
+
+void scut_suite_fail_fast(scut_suite_t*, int);
+
+void scut_suite_cache(scut_suite_t*, int);
+
+void scut_suite_isolate(scut_suite_t*, int);
+
+int scut_suite_baseline(scut_suite_t*, const char*, int);
+
+int scut_suite_no_regression(scut_suite_t*, double);
+
+int scut_suite_args(scut_suite_t*, int, char**);
+
+int scut_suite_run(scut_suite_t*, int);
+
+int scut_suite_num_tests(scut_suite_t*);
+
 #endif /* __SCUT_H__ */
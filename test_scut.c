@@ -13,10 +13,16 @@
 
 #include "scut.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <signal.h>
+#include <pthread.h>
+#include <math.h>
+#include <time.h>
+#include <malloc.h>
 
 /* Test helper functions */
 int test_1(void);
@@ -24,6 +30,7 @@ int test_2(void);
 int test_3(void);
 int test_sig(void);
 int test_sig_catch(void);
+int test_sig_catch_many(void);
 int test_fail(void);
 int test_ie_ok(void);
 int test_ie_fail(void);
@@ -31,6 +38,18 @@ int test_true_ok(void);
 int test_true_fail(void);
 int test_false_ok(void);
 int test_false_fail(void);
+int test_crash(void);
+int test_hang(void);
+int test_hang_blocked(void);
+int test_flood(void);
+int bench_sum(struct scut_bench*);
+int bench_fail(struct scut_bench*);
+int test_add(const void*);
+int prop_sum(struct scut_prop*);
+int test_fixture_pid(void);
+int test_fixture_broken(void);
+int prop_string(struct scut_prop*);
+int prop_hang(struct scut_prop*);
 
 /* Various suites */
 int test_success(void);
@@ -42,6 +61,37 @@ int test_m_assert_true(void);
 int test_m_assert_false(void);
 int test_sig_fault_no_catch(void);
 int test_sig_fault_catch(void);
+int test_thread_fault(void);
+int test_parallel(void);
+int test_parallel_crash(void);
+int test_timeout(void);
+int test_timeout_parallel(void);
+int test_large_output(void);
+int test_m_add_all(void);
+int test_many(void);
+int test_bench(void);
+int test_stats(void);
+int test_reporters(void);
+int test_suites(void);
+int test_filter(void);
+int test_history(void);
+int test_fail_fast(void);
+int test_cache(void);
+int test_param(void);
+int test_prop(void);
+int test_fixtures(void);
+int test_allocs(void);
+int test_baseline(void);
+int test_perf(void);
+int test_isolate(void);
+int test_mem(void);
+int test_floats(void);
+int test_expect(void);
+int test_stress(void);
+
+/* Test helpers */
+int run_to_buf(int, char*, size_t);
+void* run_suite(void*);
 
 int stdoutdup;
 
@@ -129,6 +179,222 @@ int main(void)
                 ret = 1;
         }
 
+        write(1, "\n", 1);
+        if (test_thread_fault())
+        {
+                char* msg = "test_thread_fault failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_parallel())
+        {
+                char* msg = "test_parallel failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_parallel_crash())
+        {
+                char* msg = "test_parallel_crash failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_timeout())
+        {
+                char* msg = "test_timeout failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_timeout_parallel())
+        {
+                char* msg = "test_timeout_parallel failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_large_output())
+        {
+                char* msg = "test_large_output failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_m_add_all())
+        {
+                char* msg = "test_m_add_all failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_many())
+        {
+                char* msg = "test_many failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_bench())
+        {
+                char* msg = "test_bench failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_stats())
+        {
+                char* msg = "test_stats failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_reporters())
+        {
+                char* msg = "test_reporters failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_suites())
+        {
+                char* msg = "test_suites failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_filter())
+        {
+                char* msg = "test_filter failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_history())
+        {
+                char* msg = "test_history failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_fail_fast())
+        {
+                char* msg = "test_fail_fast failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_cache())
+        {
+                char* msg = "test_cache failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_param())
+        {
+                char* msg = "test_param failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_prop())
+        {
+                char* msg = "test_prop failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_fixtures())
+        {
+                char* msg = "test_fixtures failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_allocs())
+        {
+                char* msg = "test_allocs failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_baseline())
+        {
+                char* msg = "test_baseline failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_perf())
+        {
+                char* msg = "test_perf failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_isolate())
+        {
+                char* msg = "test_isolate failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_mem())
+        {
+                char* msg = "test_mem failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_floats())
+        {
+                char* msg = "test_floats failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_expect())
+        {
+                char* msg = "test_expect failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
+        write(1, "\n", 1);
+        if (test_stress())
+        {
+                char* msg = "test_stress failed\n";
+                write(stdoutdup, msg, strlen(msg));
+                ret = 1;
+        }
+
         if (ret == 0)
         {
                 char* msg = "\ntest_scut: All tests passed\n";
@@ -335,6 +601,35 @@ int test_sig_fault_no_catch(void)
         return 1;
 }
 
+static void* expect_usr1(void* arg)
+{
+        SCUT_EXPECT_SIG(SIGUSR1);
+
+        return arg;
+}
+
+static void* assert_usr1(void* arg)
+{
+        return scut_assert_sig(SIGUSR1) ? arg : NULL;
+}
+
+/* Signals are expected and checked from a thread the test started */
+static int test_sig_thread(void)
+{
+        static int caught;
+        pthread_t t;
+        void* found = NULL;
+
+        SCUT_ASSERT_IE(pthread_create(&t, NULL, expect_usr1, NULL), 0);
+        pthread_join(t, NULL);
+        test_sig();
+        SCUT_ASSERT_IE(pthread_create(&t, NULL, assert_usr1, &caught), 0);
+        pthread_join(t, &found);
+        SCUT_ASSERT_TRUE(found == &caught);
+
+        return 0;
+}
+
 int test_sig_fault_catch(void)
 {
         int ret;
@@ -342,84 +637,1839 @@ int test_sig_fault_catch(void)
         scut_create("Sig fault, catch");
 
         SCUT_ADD(test_sig_catch);
+        SCUT_ADD(test_sig_catch_many);
+        SCUT_ADD(test_sig_thread);
         ret = scut_run(0);
         scut_destroy();
 
+        /* Outside a test there is nothing to expect */
+        scut_expect_sig(SIGUSR1);
+        if (scut_assert_sig(SIGUSR1))
+        {
+                ret = 1;
+        }
+
         return ret;
 }
 
-/* Various test methods */
-
-int test_1(void)
+static void* fault_thread(void* arg)
 {
-        printf("In test_1\n");
-        return 0;
+        (void)arg;
+        *(volatile int*)NULL = 1;
+
+        return NULL;
 }
 
-int test_2(void)
+/* Crashes in a thread of its own */
+static int test_fault_thread(void)
 {
-        printf("In test_2\n");
+        pthread_t t;
+
+        if (pthread_create(&t, NULL, fault_thread, NULL) == 0)
+        {
+                pthread_join(t, NULL);
+        }
+
         return 0;
 }
 
-int test_3(void)
+/* A fault in a thread the test started fails the test, once */
+int test_thread_fault(void)
 {
-        printf("In test_3\n");
-        return 1;
-}
+        char buf[4096];
+        int ret = 0;
 
-int test_fail(void)
-{
-        SCUT_FAIL("a message");
-}
+        scut_create("Thread fault");
 
-int test_ie_ok(void)
-{
-        SCUT_ASSERT_IE(1, 1);
+        SCUT_ADD(test_fault_thread);
+        SCUT_ADD(test_1);
 
-        return 0;
-}
+        for (int jobs = 1; jobs <= 2; ++jobs)
+        {
+                setenv("SCUT_JOBS", jobs == 1 ? "1" : "2", 1);
+                if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+                    !strstr(buf, "Killed by signal 11") ||
+                    !strstr(buf, "\"performed\":2,\"failed\":1}"))
+                {
+                        ret = 1;
+                }
+        }
+        unsetenv("SCUT_JOBS");
+        scut_destroy();
 
-int test_ie_fail(void)
-{
-        SCUT_ASSERT_IE(1, 0);
+        printf("%s", ret ? "Thread fault FAILED\n" : "Thread fault Ok\n");
 
-        return 0;
+        return ret;
 }
 
-int test_true_ok(void)
+int test_parallel(void)
 {
-        SCUT_ASSERT_TRUE(1);
+        int ret;
 
-        return 0;
-}
+        scut_create("Parallel");
 
-int test_true_fail(void)
-{
-        SCUT_ASSERT_TRUE(0);
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_3);
+        SCUT_ADD(test_sig);
+        SCUT_ADD(test_sig_catch);
+        SCUT_ADD(test_2);
+        ret = scut_run(SCUT_PARALLEL);
+        scut_destroy();
 
-        return 0;
+        return ret != 2;
 }
 
-int test_false_ok(void)
+int test_parallel_crash(void)
 {
-        SCUT_ASSERT_FALSE(0);
+        int ret;
 
-        return 0;
-}
+        scut_create("Parallel, worker crash");
 
-int test_false_fail(void)
-{
-        SCUT_ASSERT_FALSE(1);
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_crash);
+        SCUT_ADD(test_2);
+        setenv("SCUT_JOBS", "2", 1);
+        ret = scut_run(0);
+        unsetenv("SCUT_JOBS");
+        scut_destroy();
 
-        return 0;
+        return ret != 1;
 }
 
-int test_sig(void)
+int test_timeout(void)
 {
-        kill(getpid(), SIGUSR1);
+        int ret;
 
-        return 0;
+        scut_create("Timeout");
+
+        SCUT_ADD(test_1);
+        SCUT_ADD_TIMEOUT(test_hang, 50);
+        SCUT_ADD(test_2);
+        ret = scut_run(0);
+        if (ret != 1)
+        {
+                scut_destroy();
+                return 1;
+        }
+
+        // Suite default
+        scut_timeout(50);
+        ret = scut_run(0);
+        scut_destroy();
+
+        return ret != 1;
+}
+
+int test_timeout_parallel(void)
+{
+        int ret;
+
+        scut_create("Timeout, parallel");
+
+        scut_timeout(50);
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_hang);
+        SCUT_ADD(test_hang_blocked);
+        SCUT_ADD(test_2);
+        setenv("SCUT_JOBS", "2", 1);
+        ret = scut_run(0);
+        unsetenv("SCUT_JOBS");
+        scut_destroy();
+
+        return ret != 2;
+}
+
+int test_large_output(void)
+{
+        int ret;
+
+        // Used to deadlock on a full pipe
+        scut_create("Large output");
+
+        SCUT_ADD(test_flood);
+        SCUT_ADD(test_1);
+        ret = scut_run(0);
+        if (ret)
+        {
+                scut_destroy();
+                return 1;
+        }
+
+        setenv("SCUT_JOBS", "2", 1);
+        ret = scut_run(0);
+        unsetenv("SCUT_JOBS");
+        scut_destroy();
+
+        return ret;
+}
+
+int test_m_add_all(void)
+{
+        int ret;
+
+        scut_create("Test suite m_add_all");
+
+        SCUT_ADD_ALL();
+        ret = scut_run(0);
+        if (scut_num_tests() != 3)
+        {
+                ret = 1;
+        }
+        scut_destroy();
+
+        return ret;
+}
+
+int test_many(void)
+{
+        int ret = 0;
+
+        scut_create("Many tests");
+
+        for (int i = 0; i < 200; ++i)
+        {
+                if (scut_add(&test_ie_ok, "test_ie_ok"))
+                {
+                        ret = 1;
+                }
+        }
+        ret += scut_run(0);
+        if (scut_num_tests() != 200)
+        {
+                ret = 1;
+        }
+        scut_destroy();
+
+        return ret;
+}
+
+int test_bench(void)
+{
+        int ret;
+
+        scut_create("Benchmarks");
+
+        SCUT_ADD_BENCH(bench_sum);
+        SCUT_ADD_BENCH(bench_fail);
+        SCUT_ADD(test_1);
+        setenv("SCUT_BENCH_TIME", "20", 1);
+        ret = scut_run(0);
+        unsetenv("SCUT_BENCH_TIME");
+        scut_destroy();
+
+        return ret != 1;
+}
+
+int test_stats(void)
+{
+        int ret;
+
+        scut_create("Stats");
+
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_3);
+        SCUT_ADD(test_flood);
+        SCUT_ADD(test_2);
+        ret = scut_run(SCUT_STATS);
+        if (ret != 1)
+        {
+                scut_destroy();
+                return 1;
+        }
+
+        setenv("SCUT_SLOWEST", "2", 1);
+        setenv("SCUT_JOBS", "2", 1);
+        ret = scut_run(0);
+        unsetenv("SCUT_JOBS");
+        unsetenv("SCUT_SLOWEST");
+        scut_destroy();
+
+        return ret != 1;
+}
+
+int test_reporters(void)
+{
+        char buf[4096];
+        int ret = 0;
+
+        scut_create("Reporters");
+
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_3);
+        SCUT_ADD(test_sig);
+
+        if (run_to_buf(SCUT_TAP, buf, sizeof(buf)) != 2 ||
+            !strstr(buf, "ok 1 - test_1\n") ||
+            !strstr(buf, "not ok 2 - test_3\n") ||
+            !strstr(buf, "    In test_3\n") ||
+            !strstr(buf, "message: \"Killed by signal") ||
+            !strstr(buf, "1..3\n"))
+        {
+                ret = 1;
+        }
+
+        if (run_to_buf(SCUT_JUNIT, buf, sizeof(buf)) != 2 ||
+            !strstr(buf, "tests=\"3\" failures=\"2\"") ||
+            !strstr(buf, "<system-out>In test_3\n</system-out>") ||
+            !strstr(buf, "</testsuites>\n"))
+        {
+                ret = 1;
+        }
+
+        setenv("SCUT_REPORTER", "jsonl", 1);
+        if (run_to_buf(0, buf, sizeof(buf)) != 2 ||
+            !strstr(buf, "\"name\":\"test_3\",\"result\":\"failed\"") ||
+            !strstr(buf, "\"output\":\"In test_3\\n\"") ||
+            !strstr(buf, "\"performed\":3,\"failed\":2}\n"))
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_REPORTER");
+        scut_destroy();
+
+        printf("%s", ret ? "Reporters FAILED\n" : "Reporters Ok\n");
+
+        return ret;
+}
+
+int test_suites(void)
+{
+        pthread_t threads[4];
+        scut_suite_t* suites[4];
+        sigset_t usr1;
+        sigset_t old;
+        void* failed;
+        int ret = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+                suites[i] = scut_suite_new(i % 2 ? "Odd suite" : "Even suite");
+                scut_suite_add(suites[i], &test_1, "test_1");
+                scut_suite_add(suites[i], &test_sig_catch, "test_sig_catch");
+                scut_suite_add(suites[i], &test_3, "test_3");
+                if (i % 2)
+                {
+                        scut_suite_add(suites[i], &test_sig, "test_sig");
+                }
+                scut_suite_add(suites[i], &test_2, "test_2");
+        }
+        if (scut_suite_num_tests(suites[0]) != 4 || 
+            scut_suite_num_tests(suites[1]) != 5)
+        {
+                ret = 1;
+        }
+
+        /* Let SIGUSR1 from kill(2) reach the thread running a test */
+        sigemptyset(&usr1);
+        sigaddset(&usr1, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &usr1, &old);
+        for (int i = 0; i < 4; ++i)
+        {
+                pthread_create(threads + i, NULL, &run_suite, suites[i]);
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+                pthread_join(threads[i], &failed);
+                if ((long)failed != (i % 2 ? 2 : 1))
+                {
+                        ret = 1;
+                }
+                scut_suite_free(suites[i]);
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+        printf("%s", ret ? "Suites FAILED\n" : "Suites Ok\n");
+
+        return ret;
+}
+
+int test_filter(void)
+{
+        char* argv[] = {"test_scut", "--filter", "test_3", "--shard=0/1"};
+        char buf[4096];
+        int ret = 0;
+        int sum = 0;
+
+        scut_create("Filter");
+
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_2);
+        SCUT_ADD(test_3);
+        SCUT_ADD(test_sig);
+        SCUT_ADD(test_fail);
+
+        scut_filter("test_*,-test_sig");
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 2 ||
+            strstr(buf, "test_sig") || 
+            !strstr(buf, "\"performed\":4,\"failed\":2}"))
+        {
+                ret = 1;
+        }
+
+        /* Shards cover all tests, once */
+        scut_filter(NULL);
+        for (int i = 0; i < 3; ++i)
+        {
+                scut_shard(i, 3);
+                run_to_buf(SCUT_JSONL, buf, sizeof(buf));
+                if (!strstr(buf, i < 2 ? "\"performed\":2" : "\"performed\":1"))
+                {
+                        ret = 1;
+                }
+                sum += strstr(buf, "\"name\":\"test_3\"") != NULL;
+                sum += strstr(buf, "\"name\":\"test_sig\"") != NULL;
+        }
+        if (sum != 2 || scut_shard(3, 3) == 0)
+        {
+                ret = 1;
+        }
+
+        if (scut_args(4, argv) || scut_run(0) != 1)
+        {
+                ret = 1;
+        }
+        scut_filter(NULL);
+        scut_shard(0, 0);
+
+        setenv("SCUT_FILTER", "-test_[12]", 1);
+        setenv("SCUT_SHARD_TOTAL", "2", 1);
+        setenv("SCUT_SHARD_INDEX", "1", 1);
+        if (scut_run(0) != 1)
+        {
+                ret = 1;
+        }
+        setenv("SCUT_SHARD_INDEX", "1x", 1);
+        if (scut_run(0) == 1)
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_FILTER");
+        unsetenv("SCUT_SHARD_TOTAL");
+        unsetenv("SCUT_SHARD_INDEX");
+        scut_destroy();
+
+        printf("%s", ret ? "Filter FAILED\n" : "Filter Ok\n");
+
+        return ret;
+}
+
+int test_history(void)
+{
+        char path[] = "/tmp/scut_history_XXXXXX";
+        static char long_name[300];
+        char shard[64];
+        char buf[4096];
+        char name[64];
+        char outcome[5];
+        long long ns;
+        FILE* f;
+        int lines = 0;
+        int ret = 0;
+        int fd = mkstemp(path);
+
+        if (fd < 0)
+        {
+                return 1;
+        }
+        f = fdopen(fd, "w");
+        fprintf(f, "1000000000 test_3\n10 test_1\n10 test_2\n");
+        fclose(f);
+
+        scut_create("History");
+
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_2);
+        SCUT_ADD(test_3);
+        SCUT_ADD(test_fail);
+        scut_history(path);
+
+        /* The long test gets a shard of its own */
+        scut_shard(0, 2);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"name\":\"test_3\"") ||
+            !strstr(buf, "\"performed\":1,"))
+        {
+                ret = 1;
+        }
+        scut_shard(1, 2);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"performed\":3,") ||
+            strstr(buf, "test_2") > strstr(buf, "test_fail"))
+        {
+                ret = 1;
+        }
+
+        /* The shards split by the same history, they left it alone */
+        f = fopen(path, "r");
+        if (fscanf(f, "%lld %63s", &ns, name) != 2 || ns != 1000000000)
+        {
+                ret = 1;
+        }
+        fclose(f);
+        snprintf(shard, sizeof(shard), "%s.shard.0", path);
+
+        /* An unsharded run merges what they recorded */
+        scut_shard(0, 0);
+        scut_filter("test_1");
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 0 || 
+            access(shard, F_OK) == 0)
+        {
+                ret = 1;
+        }
+        scut_filter(NULL);
+
+        /* Both shards were recorded, the old duration only counts half */
+        f = fopen(path, "r");
+        while (fscanf(f, "%lld %4s %63s", &ns, outcome, name) == 3)
+        {
+                if (strcmp(name, "test_3") == 0)
+                {
+                        ret |= ns < 500000000 || ns > 500100000;
+                        ret |= strcmp(outcome, "fail") != 0;
+                        lines++;
+                }
+                lines += strcmp(name, "test_fail") == 0;
+        }
+        fclose(f);
+        if (lines != 2)
+        {
+                ret = 1;
+        }
+
+        /* A name longer than a line buffer is read back whole */
+        memset(long_name, 'x', sizeof(long_name) - 1);
+        scut_add(test_1, long_name);
+        scut_filter("x*");
+        scut_cache(1);
+        if (scut_run(0) != 0 || 
+            run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 0 ||
+            !strstr(buf, "\"cached\":1}"))
+        {
+                ret = 1;
+        }
+        scut_cache(0);
+        scut_filter(NULL);
+        unlink(path);
+        scut_destroy();
+
+        printf("%s", ret ? "History FAILED\n" : "History Ok\n");
+
+        return ret;
+}
+
+int test_fail_fast(void)
+{
+        char path[] = "/tmp/scut_results_XXXXXX";
+        char buf[4096];
+        char* p;
+        int ret = 0;
+        int ran = 0;
+        int skipped = 0;
+        int fd = mkstemp(path);
+
+        if (fd < 0)
+        {
+                return 1;
+        }
+        close(fd);
+
+        scut_create("Fail fast");
+
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_3);
+        SCUT_ADD(test_2);
+        SCUT_ADD(test_fail);
+        SCUT_ADD(test_ie_ok);
+        scut_history(path);
+
+        scut_fail_fast(1);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            strstr(buf, "test_2") ||
+            !strstr(buf, "\"performed\":2,\"failed\":1,\"skipped\":3}"))
+        {
+                ret = 1;
+        }
+        /* JUnit lists the skipped tests, and counts them in tests */
+        if (run_to_buf(SCUT_JUNIT, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "tests=\"5\" failures=\"1\" errors=\"0\" skipped=\"3\"") ||
+            !(p = strstr(buf, "name=\"test_2\" time=\"0\">\n      <skipped message=\"fail fast\"/>")) ||
+            !strstr(p, "name=\"test_ie_ok\""))
+        {
+                ret = 1;
+        }
+
+        /* The last failures now run first */
+        scut_fail_fast(0);
+        scut_run(0);
+        scut_failed_first(1);
+        scut_fail_fast(2);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 2 ||
+            !strstr(buf, "\"performed\":2,\"failed\":2,\"skipped\":3}") ||
+            !(p = strstr(buf, "test_start\",\"name\":\"test_3\"")) ||
+            !strstr(p, "test_start\",\"name\":\"test_fail\""))
+        {
+                ret = 1;
+        }
+        scut_failed_first(0);
+
+        /* Whatever ran in parallel is counted, the rest is skipped */
+        scut_fail_fast(1);
+        setenv("SCUT_JOBS", "2", 1);
+        run_to_buf(SCUT_JSONL, buf, sizeof(buf));
+        unsetenv("SCUT_JOBS");
+        p = strstr(buf, "\"performed\":");
+        if (!p || sscanf(p, "\"performed\":%d,\"failed\":%*d,\"skipped\":%d", 
+                         &ran, &skipped) != 2 || ran + skipped != 5)
+        {
+                ret = 1;
+        }
+
+        /* Counts that are not numbers are rejected, not read as 0 */
+        if (scut_args(2, (char*[]){"test", "--fail-fast=x"}) == 0 ||
+            scut_args(2, (char*[]){"test", "--fail-fast=-1"}) == 0 ||
+            scut_args(2, (char*[]){"test", "--isolate=2x"}) == 0 ||
+            scut_args(2, (char*[]){"test", "--fail-fast=2"}) != 0)
+        {
+                ret = 1;
+        }
+        scut_fail_fast(0);
+        setenv("SCUT_FAIL_FAST", "one", 1);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 5)
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_FAIL_FAST");
+        setenv("SCUT_ISOLATE", "-1", 1);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 5)
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_ISOLATE");
+        for (int i = 0; i < 3; ++i)
+        {
+                const char* name[] = {"SCUT_JOBS", "SCUT_TIMEOUT", "SCUT_SLOWEST"};
+
+                setenv(name[i], "2x", 1);
+                if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 5)
+                {
+                        ret = 1;
+                }
+                unsetenv(name[i]);
+        }
+        unlink(path);
+        scut_destroy();
+
+        printf("%s", ret ? "Fail fast FAILED\n" : "Fail fast Ok\n");
+
+        return ret;
+}
+
+int test_cache(void)
+{
+        char path[] = "/tmp/scut_cache_XXXXXX";
+        char buf[4096];
+        int ret = 0;
+        int fd = mkstemp(path);
+
+        if (fd < 0)
+        {
+                return 1;
+        }
+        close(fd);
+
+        scut_create("Cache");
+
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_3);
+        SCUT_ADD(test_2);
+        scut_history(path);
+        scut_cache(1);
+
+        /* Only the failed test runs again */
+        scut_run(0);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"name\":\"test_1\",\"result\":\"cached\"") ||
+            !strstr(buf, "\"name\":\"test_3\",\"result\":\"failed\"") ||
+            !strstr(buf, "\"performed\":1,\"failed\":1,\"cached\":2}"))
+        {
+                ret = 1;
+        }
+        if (run_to_buf(SCUT_TAP, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "ok 3 - test_2 # SKIP cached\n"))
+        {
+                ret = 1;
+        }
+        setenv("SCUT_JOBS", "2", 1);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"performed\":1,\"failed\":1,\"cached\":2}"))
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_JOBS");
+
+        /* Forced, everything runs */
+        setenv("SCUT_FORCE", "1", 1);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"performed\":3,\"failed\":1}"))
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_FORCE");
+
+        /* Cached tests after fail fast stopped are cached, not skipped */
+        SCUT_ADD(test_fail);
+        scut_fail_fast(1);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"name\":\"test_2\",\"result\":\"cached\"") ||
+            strstr(buf, "\"name\":\"test_fail\"") ||
+            !strstr(buf, "\"performed\":1,\"failed\":1,\"cached\":2,\"skipped\":1}") ||
+            run_to_buf(0, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "Result: 1 performed\n"))
+        {
+                ret = 1;
+        }
+        setenv("SCUT_JOBS", "2", 1);
+        run_to_buf(SCUT_JSONL, buf, sizeof(buf));
+        unsetenv("SCUT_JOBS");
+        if (!strstr(buf, "\"performed\":1,\"failed\":1,\"cached\":2,\"skipped\":1}") &&
+            !strstr(buf, "\"performed\":2,\"failed\":2,\"cached\":2}"))
+        {
+                ret = 1;
+        }
+        scut_fail_fast(0);
+        unlink(path);
+        scut_destroy();
+
+        printf("%s", ret ? "Cache FAILED\n" : "Cache Ok\n");
+
+        return ret;
+}
+
+/* Cases of test_add, a + b == sum */
+struct add_case
+{
+        int a;
+        int b;
+        int sum;
+};
+
+static struct add_case add_cases[100];
+
+int test_param(void)
+{
+        static char buf[32768];
+        int ret = 0;
+
+        for (int i = 0; i < 100; ++i)
+        {
+                add_cases[i].a = i;
+                add_cases[i].b = 2 * i;
+                add_cases[i].sum = i == 42 ? 0 : 3 * i;
+        }
+
+        scut_create("Param");
+
+        SCUT_ADD(test_1);
+        SCUT_ADD_PARAM(test_add, add_cases, 100);
+        SCUT_ADD(test_2);
+        if (scut_num_tests() != 102 || 
+            scut_add_param(&test_add, "test_add", add_cases, 1, 0) == 0)
+        {
+                ret = 1;
+        }
+
+        /* Cases are tests of their own */
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"name\":\"test_add[42]\",\"result\":\"failed\"") ||
+            !strstr(buf, "\"performed\":102,\"failed\":1}"))
+        {
+                ret = 1;
+        }
+        scut_filter("test_add?4*,test_2");
+        if (run_to_buf(SCUT_TAP, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "ok 1 - test_add[4]\n") || 
+            !strstr(buf, "not ok 4 - test_add[42]\n") ||
+            !strstr(buf, "ok 12 - test_2\n"))
+        {
+                ret = 1;
+        }
+        scut_filter(NULL);
+
+        /* Parallel workers and shards split the table */
+        setenv("SCUT_JOBS", "2", 1);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1)
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_JOBS");
+        scut_shard(0, 2);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 0 ||
+            !strstr(buf, "\"name\":\"test_add[1]\"") ||
+            !strstr(buf, "\"performed\":51,\"failed\":0}"))
+        {
+                ret = 1;
+        }
+        scut_shard(0, 0);
+        scut_destroy();
+
+        printf("%s", ret ? "Param FAILED\n" : "Param Ok\n");
+
+        return ret;
+}
+
+int test_prop(void)
+{
+        char buf[4096];
+        char* seed;
+        int ret = 0;
+
+        scut_create("Property");
+
+        SCUT_ADD_PROP(prop_sum);
+        scut_add_prop(&prop_string, "prop_string", 100, 0);
+
+        /* Shrunk to the smallest failing input */
+        if (run_to_buf(SCUT_VERBOSE, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "a=1000 b=0\n") ||
+            !strstr(buf, "100 cases passed") ||
+            (seed = strstr(buf, "SCUT_SEED=")) == NULL)
+        {
+                ret = 1;
+        }
+        else
+        {
+                /* The seed makes the first case fail */
+                *strchr(seed, '\n') = 0;
+                setenv("SCUT_SEED", seed + strlen("SCUT_SEED="), 1);
+                if (run_to_buf(0, buf, sizeof(buf)) != 1 ||
+                    !strstr(buf, "Falsified after 1 cases"))
+                {
+                        ret = 1;
+                }
+                unsetenv("SCUT_SEED");
+        }
+
+        /* Spread over processes, for a time */
+        scut_destroy();
+        scut_create("Property");
+        scut_add_prop(&prop_string, "prop_string", 0, 50);
+        scut_add_prop(&prop_sum, "prop_sum", 20000, 0);
+        setenv("SCUT_PROP_JOBS", "2", 1);
+        if (run_to_buf(0, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "a=1000 b=0\n"))
+        {
+                ret = 1;
+        }
+
+        /* A timeout stops the processes, none are left behind */
+        scut_destroy();
+        scut_create("Property");
+        scut_add_prop(&prop_hang, "prop_hang", 20000, 0);
+        scut_timeout(100);
+        if (run_to_buf(0, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "Timed out") ||
+            waitpid(-1, NULL, WNOHANG) != -1)
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_PROP_JOBS");
+        scut_destroy();
+
+        printf("%s", ret ? "Property FAILED\n" : "Property Ok\n");
+
+        return ret;
+}
+
+/* Fixture bookkeeping, of the process running the suite */
+static pid_t main_pid;
+static pid_t fixture_pid;
+static int builds;
+static int teardowns;
+static int setups;
+
+static int pid_setup(void** data)
+{
+        builds++;
+        fixture_pid = getpid();
+        *data = &fixture_pid;
+
+        return 0;
+}
+
+static void pid_teardown(void* data)
+{
+        if (data == &fixture_pid)
+        {
+                teardowns++;
+        }
+}
+
+static int broken_setup(void** data)
+{
+        (void)data;
+        builds++;
+
+        return 1;
+}
+
+static int count_setup(void)
+{
+        setups++;
+
+        return 0;
+}
+
+static int count_teardown(void)
+{
+        setups--;
+
+        return 0;
+}
+
+SCUT_FIXTURE(pid_fixture, &pid_setup, &pid_teardown);
+SCUT_FIXTURE(broken_fixture, &broken_setup, NULL);
+
+int test_fixtures(void)
+{
+        char buf[4096];
+        int ret = 0;
+
+        scut_create("Fixtures");
+
+        SCUT_ADD(test_1);
+        SCUT_ADD(test_fixture_pid);
+        SCUT_USE(pid_fixture);
+        SCUT_ADD(test_3);
+        SCUT_ADD(test_fixture_pid);
+        SCUT_USE(pid_fixture);
+        SCUT_ADD(test_fixture_broken);
+        SCUT_USE(pid_fixture);
+        SCUT_USE(broken_fixture);
+        scut_setup(&count_setup, &count_teardown);
+        main_pid = getpid();
+
+        /* Built once, on first use, and torn down at the end */
+        builds = 0;
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 2 ||
+            builds != 2 || teardowns != 1 || setups != 0 ||
+            !strstr(buf, "Fixture broken_fixture failed to set up"))
+        {
+                ret = 1;
+        }
+
+        /* Built before the workers fork, they see the same */
+        setenv("SCUT_JOBS", "2", 1);
+        builds = 0;
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 2 ||
+            builds != 2 || teardowns != 2)
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_JOBS");
+
+        /* Not built if no selected test uses it */
+        scut_filter("test_1");
+        builds = 0;
+        if (scut_run(0) != 0 || builds != 0 || teardowns != 2)
+        {
+                ret = 1;
+        }
+        scut_destroy();
+
+        printf("%s", ret ? "Fixtures FAILED\n" : "Fixtures Ok\n");
+
+        return ret;
+}
+
+static void* alloc_kept;
+
+/* Leaks one block */
+static int test_alloc_leak(void)
+{
+        char* p = malloc(16);
+
+        if (alloc_kept == NULL)
+        {
+                alloc_kept = malloc(100);
+        }
+        p = realloc(p, 1000);
+        free(p);
+
+        return 0;
+}
+
+static int test_alloc_none(void)
+{
+        int n = 0;
+
+        SCUT_ASSERT_NO_ALLOC
+        {
+                n++;
+        }
+
+        return n != 1;
+}
+
+static int test_alloc_over(void)
+{
+        SCUT_ASSERT_MAX_ALLOCS(1)
+        {
+                free(malloc(8));
+                free(malloc(8));
+        }
+
+        return 0;
+}
+
+/* Aligned blocks are counted, and are not leaks once freed */
+static int test_alloc_aligned(void)
+{
+        void* p = NULL;
+
+        if (posix_memalign(&p, 64, 1000) == 0)
+        {
+                free(p);
+        }
+        free(memalign(4096, 100));
+
+        return 0;
+}
+
+int test_allocs(void)
+{
+        static char buf[4096];
+        char* p;
+        int ret = 0;
+
+        scut_create("Allocations");
+
+        SCUT_ADD(test_alloc_leak);
+        SCUT_ADD(test_alloc_none);
+        SCUT_ADD(test_alloc_over);
+        SCUT_ADD(test_alloc_aligned);
+
+        /* Only reported when asked for, the budget always holds */
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            strstr(buf, "\"allocs\""))
+        {
+                ret = 1;
+        }
+#if defined(__GLIBC__)
+        if (!strstr(buf, "2 allocations, expected at most 1"))
+        {
+                ret = 1;
+        }
+        free(alloc_kept);
+        alloc_kept = NULL;
+        if (run_to_buf(SCUT_JSONL | SCUT_ALLOCS, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"count\":3,") ||
+            !strstr(buf, "\"leaked_blocks\":1,") ||
+            !strstr(buf, "\"count\":0,") ||
+            !(p = strstr(buf, "\"name\":\"test_alloc_aligned\"")) ||
+            !strstr(p, "\"count\":2,") ||
+            !strstr(p, "\"leaked_blocks\":0,"))
+        {
+                ret = 1;
+        }
+        free(alloc_kept);
+        alloc_kept = NULL;
+        setenv("SCUT_JOBS", "2", 1);
+        setenv("SCUT_ALLOCS", "1", 1);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"leaked_blocks\":1,"))
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_ALLOCS");
+        unsetenv("SCUT_JOBS");
+#endif
+        scut_destroy();
+
+        printf("%s", ret ? "Allocations FAILED\n" : "Allocations Ok\n");
+
+        return ret;
+}
+
+static int spin_work = 100;
+
+static int bench_spin(struct scut_bench* bench)
+{
+        SCUT_BENCH_LOOP
+        {
+                for (volatile int i = 0; i < spin_work; ++i)
+                {
+                }
+        }
+
+        return 0;
+}
+
+int test_baseline(void)
+{
+        char path[] = "/tmp/scut_baseline_XXXXXX";
+        static char long_name[300];
+        static char buf[4096];
+        char name[64];
+        double mean;
+        double var;
+        long long n;
+        FILE* f;
+        int lines = 0;
+        int ret = 0;
+        int fd = mkstemp(path);
+
+        if (fd < 0)
+        {
+                return 1;
+        }
+        close(fd);
+        unlink(path);
+
+        scut_create("Baseline");
+
+        SCUT_ADD_BENCH(bench_spin);
+        SCUT_ASSERT_NO_REGRESSION(0.5);
+        SCUT_ADD(test_1);
+        setenv("SCUT_BENCH_TIME", "20", 1);
+
+        /* Saving twice merges the samples */
+        scut_baseline(path, 1);
+        if (scut_run(0) != 0 || scut_run(0) != 0)
+        {
+                ret = 1;
+        }
+        f = fopen(path, "r");
+        while (f && fscanf(f, "%lld %lf %lf %63s", &n, &mean, &var, name) == 4)
+        {
+                if (strcmp(name, "bench_spin") == 0)
+                {
+                        ret |= n < 4 || mean <= 0 || var < 0;
+                        lines++;
+                }
+                if (strcmp(name, "test_1") == 0)
+                {
+                        ret |= n != 2;
+                        lines++;
+                }
+        }
+        if (f == NULL || lines != 2)
+        {
+                ret = 1;
+        }
+        if (f)
+        {
+                fclose(f);
+        }
+
+        /* Compared, and only failed when clearly slower */
+        scut_baseline(path, 0);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 0 ||
+            !strstr(buf, "\"baseline\":{"))
+        {
+                ret = 1;
+        }
+        spin_work = 4000;
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "Slower than the baseline by more than 50%"))
+        {
+                ret = 1;
+        }
+        spin_work = 100;
+
+        /* New tests are added */
+        SCUT_ADD(test_2);
+        if (scut_run(0) != 0)
+        {
+                ret = 1;
+        }
+        f = fopen(path, "r");
+        n = f ? (long long)fread(buf, 1, sizeof(buf) - 1, f) : 0;
+        buf[n] = 0;
+        if (f == NULL || strstr(buf, " test_2\n") == NULL)
+        {
+                ret = 1;
+        }
+        if (f)
+        {
+                fclose(f);
+        }
+
+        /* A long name is found again rather than added twice */
+        memset(long_name, 'x', sizeof(long_name) - 1);
+        scut_add(test_2, long_name);
+        if (scut_run(0) != 0 || scut_run(0) != 0)
+        {
+                ret = 1;
+        }
+        f = fopen(path, "r");
+        lines = 0;
+        while (f && (fd = fgetc(f)) != EOF)
+        {
+                lines += fd == '\n';
+        }
+        if (f == NULL || lines != 4)
+        {
+                ret = 1;
+        }
+        if (f)
+        {
+                fclose(f);
+        }
+        unsetenv("SCUT_BENCH_TIME");
+        unlink(path);
+        scut_destroy();
+
+        printf("%s", ret ? "Baseline FAILED\n" : "Baseline Ok\n");
+
+        return ret;
+}
+
+/* Touches fresh pages, 4096 page faults */
+static int test_perf_faults(void)
+{
+        size_t size = 16 << 20;
+        char* p = malloc(size);
+
+        SCUT_ASSERT_MAX_EVENTS(SCUT_PERF_PAGE_FAULTS, 10)
+        {
+                memset(p, 1, size);
+        }
+        free(p);
+
+        return 0;
+}
+
+int test_perf(void)
+{
+        static char buf[4096];
+        int expected = 0;
+        int ret = 0;
+
+        scut_create("Performance counters");
+
+        SCUT_ADD(test_perf_faults);
+        SCUT_ADD(test_1);
+
+        /* Unavailable counters are reported, but fail nothing */
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) > 1 ||
+            strstr(buf, "\"perf\""))
+        {
+                ret = 1;
+        }
+        if (run_to_buf(SCUT_JSONL | SCUT_PERF, buf, sizeof(buf)) > 1 ||
+            !strstr(buf, ",\"perf\":{\"instructions\":") ||
+            !strstr(buf, "\"context_switches\":"))
+        {
+                ret = 1;
+        }
+        if (!strstr(buf, "\"page_faults\":null"))
+        {
+                expected = 1;
+                ret |= !strstr(buf, "page faults, expected at most 10");
+        }
+        setenv("SCUT_JOBS", "2", 1);
+        setenv("SCUT_PERF", "1", 1);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != expected ||
+            !strstr(buf, "\"tlb_misses\":"))
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_PERF");
+        unsetenv("SCUT_JOBS");
+        scut_destroy();
+
+        printf("%s", ret ? "Performance counters FAILED\n" : 
+               "Performance counters Ok\n");
+
+        return ret;
+}
+
+static int isolate_state;
+
+/* Leaves the process dirty, and fails */
+static int test_isolate_dirty(void)
+{
+        isolate_state = 100;
+
+        return 1;
+}
+
+/* Only passes in a process no test has touched */
+static int test_isolate_clean(void)
+{
+        return isolate_state++ != 0;
+}
+
+int test_isolate(void)
+{
+        int ret = 0;
+
+        scut_create("Isolation");
+
+        SCUT_ADD(test_isolate_dirty);
+        SCUT_ADD(test_isolate_clean);
+        SCUT_ADD(test_isolate_clean);
+
+        /* The process is replaced after the failure, and after each test */
+        scut_isolate(10);
+        if (scut_run(0) != 2 || isolate_state != 0)
+        {
+                ret = 1;
+        }
+        scut_isolate(1);
+        if (scut_run(0) != 1 || isolate_state != 0)
+        {
+                ret = 1;
+        }
+        setenv("SCUT_JOBS", "2", 1);
+        if (scut_run(0) != 1 || isolate_state != 0)
+        {
+                ret = 1;
+        }
+        unsetenv("SCUT_JOBS");
+
+        /* Without isolation the state leaks into later tests */
+        scut_isolate(0);
+        if (scut_run(0) != 3 || isolate_state != 102)
+        {
+                ret = 1;
+        }
+        isolate_state = 0;
+        scut_destroy();
+
+        printf("%s", ret ? "Isolation FAILED\n" : "Isolation Ok\n");
+
+        return ret;
+}
+
+static int test_mem_buffers(void)
+{
+        size_t n = 1 << 20;
+        unsigned char* a = malloc(n);
+        unsigned char* b = malloc(n);
+        int ret = 1;
+
+        memset(a, 7, n);
+        memset(b, 7, n);
+        SCUT_ASSERT_MEM_EQ(a, b, n);
+        b[5000] = 1;
+        b[5001] = 2;
+        b[n - 1] = 3;
+        if (scut_mem_eq(a, b, n, 1, __FILE__, __LINE__))
+        {
+                ret = 2;
+        }
+        free(a);
+        free(b);
+
+        return ret;
+}
+
+static int test_mem_array(void)
+{
+        int found[] = {1, 2, 3, 4, 5};
+        int expected[] = {1, 2, 3, 9, 5};
+
+        SCUT_ASSERT_ARRAY_EQ(found, found, 5);
+        SCUT_ASSERT_ARRAY_EQ(found, expected, 5);
+
+        return 0;
+}
+
+int test_mem(void)
+{
+        static char buf[8192];
+        int ret = 0;
+
+        scut_create("Memory comparison");
+
+        SCUT_ADD(test_mem_buffers);
+        SCUT_ADD(test_mem_array);
+
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 2 ||
+            !strstr(buf, "differ at offset 5000, 3 of 1048576 bytes differ") ||
+            !strstr(buf, "  00001380 found    07 07 07 07 07 07 07 07") ||
+            !strstr(buf, "expected 07 07 07 07 07 07 07 07 01 02 07") ||
+            !strstr(buf, "^^ ^^\\n") ||
+            !strstr(buf, "offset 12 (element 3), 1 of 20 bytes differ"))
+        {
+                ret = 1;
+        }
+        scut_destroy();
+
+        printf("%s", ret ? "Memory comparison FAILED\n" : 
+               "Memory comparison Ok\n");
+
+        return ret;
+}
+
+static int test_float_scalar(void)
+{
+        float one = 1.0f;
+
+        SCUT_ASSERT_NEAR(0.1 + 0.2, 0.3, 1e-12);
+        SCUT_ASSERT_REL(1e10 + 1, 1e10, 1e-9);
+        SCUT_ASSERT_ULP(0.1 + 0.2, 0.3, 1);
+        SCUT_ASSERT_ULP(0.0, -0.0, 0);
+        SCUT_ASSERT_ULP(one, nextafterf(one, 2), 1);
+        SCUT_ASSERT_ULP(one, nextafterf(nextafterf(one, 2), 2), 1);
+
+        return 0;
+}
+
+static int test_float_array(void)
+{
+        size_t n = 100000;
+        double* a = malloc(n * sizeof(double));
+        double* b = malloc(n * sizeof(double));
+        int ret = 1;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+                a[i] = b[i] = sin((double)i);
+        }
+        a[10] = b[10] = NAN;
+        SCUT_ASSERT_ARRAY_NEAR(a, b, n, 0);
+        a[500] += 1e-10;
+        SCUT_ASSERT_ARRAY_NEAR(a, b, n, 1e-9);
+        a[70000] += 1e-5;
+        a[99999] += 2e-4;
+        if (scut_float_eq(a, b, n, sizeof(double), SCUT_TOL_ABS, 1e-6, 
+                          __FILE__, __LINE__))
+        {
+                ret = 2;
+        }
+        free(a);
+        free(b);
+
+        return ret;
+}
+
+static int test_float_special(void)
+{
+        float a[] = {1, INFINITY, -INFINITY, NAN, 0, 4};
+        float b[] = {1, INFINITY, -INFINITY, NAN, -0.0f, 4};
+
+        SCUT_ASSERT_ARRAY_ULP(a, b, 6, 0);
+        SCUT_ASSERT_ARRAY_REL(a, b, 6, 0);
+        b[3] = 3;
+        SCUT_ASSERT_ARRAY_ULP(a, b, 6, 1000);
+
+        return 0;
+}
+
+int test_floats(void)
+{
+        static char buf[8192];
+        int ret = 0;
+
+        scut_create("Floating point comparison");
+
+        SCUT_ADD(test_float_scalar);
+        SCUT_ADD(test_float_array);
+        SCUT_ADD(test_float_special);
+
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 3 ||
+            !strstr(buf, "found 1, expected 1.00000024, error 2 is more than 1 ulp") ||
+            !strstr(buf, "2 of 100000 elements differ by more than 1e-06:") ||
+            !strstr(buf, "worst at index 99999: found ") ||
+            !strstr(buf, "errors 0: 99997, <=1e-09: 1, <=0.001: 2\\n") ||
+            !strstr(buf, "errors 0: 5, >65536: 1\\n") ||
+            !strstr(buf, "1 of 6 elements differ by more than 1000 ulp") ||
+            !strstr(buf, "worst at index 3: found nan, expected 3, error inf"))
+        {
+                ret = 1;
+        }
+        scut_destroy();
+
+        printf("%s", ret ? "Floating point comparison FAILED\n" : 
+               "Floating point comparison Ok\n");
+
+        return ret;
+}
+
+static int expect_reached;
+
+static int test_expect_pass(void)
+{
+        int three = 3;
+
+        SCUT_EXPECT_IE(three, 3);
+        SCUT_EXPECT_TRUE(three > 2);
+        SCUT_EXPECT_FALSE(three > 3);
+        SCUT_EXPECT_NEAR(0.1 + 0.2, 0.3, 1e-12);
+        SCUT_EXPECT_REL(1e10 + 1, 1e10, 1e-9);
+        SCUT_EXPECT_ULP(0.1 + 0.2, 0.3, 1);
+
+        return 0;
+}
+
+static int test_expect_fail(void)
+{
+        int three = 3;
+        float one = 1.0f;
+
+        SCUT_EXPECT_IE(three + 1, 5);
+        SCUT_EXPECT_TRUE(three == 2);
+        SCUT_EXPECT_ULP(one, 1.5f, 4);
+        SCUT_EXPECT_NEAR(three, NAN, 1);
+        expect_reached = 1;
+
+        return 0;
+}
+
+static int test_expect_many(void)
+{
+        for (int i = 0; i < 40; ++i)
+        {
+                SCUT_EXPECT_IE(i, -1);
+        }
+
+        return 0;
+}
+
+int test_expect(void)
+{
+        static char buf[16384];
+        int ret = 0;
+
+        scut_create("Expectations");
+
+        SCUT_ADD(test_expect_pass);
+        SCUT_ADD(test_expect_fail);
+        SCUT_ADD(test_expect_many);
+
+        for (int jobs = 1; jobs <= 2; ++jobs)
+        {
+                setenv("SCUT_JOBS", jobs == 1 ? "1" : "2", 1);
+                expect_reached = 0;
+                if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 2 ||
+                    (jobs == 1 && !expect_reached) ||
+                    strstr(buf, "\"name\":\"test_expect_pass\",\"result\":\"ok\"") == NULL ||
+                    !strstr(buf, "\"message\":\"4 expectations failed\"") ||
+                    !strstr(buf, "\"expectations_failed\":4,\"failures\":[{\"file\":\"test_scut.c\"") ||
+                    !strstr(buf, "\"expr\":\"three + 1 == 5\",\"message\":\"Expectation failed, three + 1 == 5: found 4, expected 5: test_scut.c+") ||
+                    !strstr(buf, "\"expr\":\"three == 2\"") ||
+                    !strstr(buf, "expected true: test_scut.c+") ||
+                    !strstr(buf, "\"expected\":true}") ||
+                    !strstr(buf, "found 1, expected 1.5, error 4194304 is more than 4 ulp") ||
+                    !strstr(buf, "\"found\":3,\"expected\":null,\"tolerance\":1,\"tolerance_kind\":\"abs\"}]") ||
+                    !strstr(buf, "\"expectations_failed\":40,") ||
+                    !strstr(buf, "found 31, expected -1") ||
+                    strstr(buf, "found 32, expected -1"))
+                {
+                        ret = 1;
+                }
+        }
+        unsetenv("SCUT_JOBS");
+        if (run_to_buf(0, buf, sizeof(buf)) != 2 ||
+            !strstr(buf, "> 4 expectations failed\n> Expectation failed, three + 1 == 5") ||
+            !strstr(buf, "> 8 more not recorded\n"))
+        {
+                ret = 1;
+        }
+        scut_destroy();
+
+        printf("%s", ret ? "Expectations FAILED\n" : "Expectations Ok\n");
+
+        return ret;
+}
+
+static pthread_mutex_t stress_lock = PTHREAD_MUTEX_INITIALIZER;
+static long long stress_count;
+
+static int stress_incr(int thread, long long i)
+{
+        (void)thread;
+        (void)i;
+        pthread_mutex_lock(&stress_lock);
+        stress_count++;
+        pthread_mutex_unlock(&stress_lock);
+
+        return 0;
+}
+
+static int stress_fail(int thread, long long i)
+{
+        SCUT_ASSERT_FALSE(thread == 2 && i == 100);
+
+        return 0;
+}
+
+static int stress_expect(int thread, long long i)
+{
+        (void)thread;
+        SCUT_EXPECT_TRUE(i != 7);
+
+        return 0;
+}
+
+static void* expect_thread(void* arg)
+{
+        (void)arg;
+        SCUT_EXPECT_IE(1, 2);
+
+        return NULL;
+}
+
+/* Counts calls until stopped */
+static long long stress_calls;
+
+static int stress_spin(int thread, long long i)
+{
+        (void)thread;
+        (void)i;
+        __sync_fetch_and_add(&stress_calls, 1);
+
+        return 0;
+}
+
+/* Thread 1 crashes at its iteration 20 */
+static int stress_crash(int thread, long long i)
+{
+        if (thread == 1 && i == 20)
+        {
+                *(volatile int*)NULL = 1;
+        }
+
+        return 0;
+}
+
+static int test_stress_ok(void)
+{
+        stress_count = 0;
+        SCUT_STRESS(4, 10000, stress_incr);
+        SCUT_ASSERT_IE(stress_count, 40000);
+
+        return 0;
+}
+
+static int test_stress_fail(void)
+{
+        SCUT_STRESS(4, 1000, stress_fail);
+
+        return 0;
+}
+
+static int test_stress_crash(void)
+{
+        SCUT_STRESS(4, 100, stress_crash);
+
+        return 0;
+}
+
+static int test_stress_timeout(void)
+{
+        SCUT_STRESS(2, 1LL << 60, stress_spin);
+
+        return 0;
+}
+
+static int test_stress_expect(void)
+{
+        SCUT_STRESS(3, 10, stress_expect);
+
+        return 0;
+}
+
+static int test_thread_expect(void)
+{
+        pthread_t t;
+
+        SCUT_ASSERT_IE(pthread_create(&t, NULL, expect_thread, NULL), 0);
+        pthread_join(t, NULL);
+
+        return 0;
+}
+
+int test_stress(void)
+{
+        static char buf[8192];
+        long long calls;
+        int ret = 0;
+
+        scut_create("Stress");
+
+        SCUT_ADD(test_stress_ok);
+        SCUT_ADD(test_stress_fail);
+        SCUT_ADD(test_stress_expect);
+        SCUT_ADD(test_thread_expect);
+        SCUT_ADD(test_stress_crash);
+
+        for (int jobs = 1; jobs <= 2; ++jobs)
+        {
+                setenv("SCUT_JOBS", jobs == 1 ? "1" : "2", 1);
+                if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 4 ||
+                    !strstr(buf, "1 of 4 threads failed, the first at iteration 20 of thread 1 with signal 11") ||
+                    !strstr(buf, "\"result\":\"ok\",\"signal\":0,\"ns\"") ||
+                    !strstr(buf, "\"stress\":{\"threads\":4,\"iterations\":40000,") ||
+                    !strstr(buf, "\"stress\":{\"threads\":4,\"iterations\":3100,") ||
+                    !strstr(buf, "\"failed_threads\":1}") ||
+                    !strstr(buf, "1 of 4 threads failed, the first at iteration 100 of thread 2") ||
+                    !strstr(buf, "\"message\":\"3 expectations failed\"") ||
+                    !strstr(buf, "\"message\":\"1 expectation failed\"") ||
+                    !strstr(buf, "\"expr\":\"1 == 2\""))
+                {
+                        ret = 1;
+                }
+        }
+        unsetenv("SCUT_JOBS");
+
+        /* A timeout stops and joins the threads before the test ends */
+        scut_destroy();
+        scut_create("Stress");
+        SCUT_ADD_TIMEOUT(test_stress_timeout, 100);
+        if (run_to_buf(SCUT_JSONL, buf, sizeof(buf)) != 1 ||
+            !strstr(buf, "\"result\":\"timed out\""))
+        {
+                ret = 1;
+        }
+        calls = __sync_fetch_and_add(&stress_calls, 0);
+        nanosleep(&(struct timespec){0, 20000000}, NULL);
+        if (__sync_fetch_and_add(&stress_calls, 0) != calls)
+        {
+                ret = 1;
+        }
+        scut_destroy();
+
+        printf("%s", ret ? "Stress FAILED\n" : "Stress Ok\n");
+
+        return ret;
+}
+
+/* Run a suite a few times, return the failures if they are the same */
+void* run_suite(void* s)
+{
+        long failed = scut_suite_run(s, 0);
+
+        for (int i = 0; i < 20; ++i)
+        {
+                if (scut_suite_run(s, 0) != failed)
+                {
+                        return (void*)-1L;
+                }
+        }
+
+        return (void*)failed;
+}
+
+/* Run the suite with the report redirected into buf */
+int run_to_buf(int flags, char* buf, size_t len)
+{
+        FILE* tmp = tmpfile();
+        int saved = dup(1);
+        ssize_t n;
+        int ret;
+
+        fflush(stdout);
+        dup2(fileno(tmp), 1);
+        ret = scut_run(flags);
+        dup2(saved, 1);
+        close(saved);
+
+        n = pread(fileno(tmp), buf, len - 1, 0);
+        buf[n > 0 ? n : 0] = 0;
+        fclose(tmp);
+
+        return ret;
+}
+
+/* Various test methods */
+
+SCUT_TEST(test_auto_1)
+{
+        SCUT_ASSERT_IE(1, 1);
+
+        return 0;
+}
+
+SCUT_TEST(test_auto_2)
+{
+        SCUT_ASSERT_TRUE(1);
+
+        return 0;
+}
+
+SCUT_BENCH(bench_auto)
+{
+        SCUT_BENCH_LOOP
+        {
+                SCUT_DO_NOT_OPTIMIZE(scut_i);
+        }
+
+        return 0;
+}
+
+int test_1(void)
+{
+        printf("In test_1\n");
+        return 0;
+}
+
+int test_2(void)
+{
+        printf("In test_2\n");
+        return 0;
+}
+
+int test_3(void)
+{
+        printf("In test_3\n");
+        return 1;
+}
+
+int test_fail(void)
+{
+        SCUT_FAIL("a message");
+}
+
+int test_ie_ok(void)
+{
+        SCUT_ASSERT_IE(1, 1);
+
+        return 0;
+}
+
+int test_ie_fail(void)
+{
+        SCUT_ASSERT_IE(1, 0);
+
+        return 0;
+}
+
+int test_true_ok(void)
+{
+        SCUT_ASSERT_TRUE(1);
+
+        return 0;
+}
+
+int test_true_fail(void)
+{
+        SCUT_ASSERT_TRUE(0);
+
+        return 0;
+}
+
+int test_false_ok(void)
+{
+        SCUT_ASSERT_FALSE(0);
+
+        return 0;
+}
+
+int test_false_fail(void)
+{
+        SCUT_ASSERT_FALSE(1);
+
+        return 0;
+}
+
+int test_sig(void)
+{
+        kill(getpid(), SIGUSR1);
+
+        return 0;
 }
 
 int test_sig_catch(void)
@@ -432,3 +2482,152 @@ int test_sig_catch(void)
 
         return 0;
 }
+
+/* Several signals are expected and caught independently */
+int test_sig_catch_many(void)
+{
+        SCUT_EXPECT_SIG(SIGUSR1);
+        SCUT_EXPECT_SIG(SIGUSR2);
+
+        test_sig();
+        SCUT_ASSERT_FALSE(scut_assert_sig(SIGUSR2));
+        raise(SIGUSR2);
+
+        SCUT_ASSERT_SIG(SIGUSR1);
+        SCUT_ASSERT_SIG(SIGUSR2);
+
+        return 0;
+}
+
+int test_crash(void)
+{
+        kill(getpid(), SIGKILL);
+
+        return 0;
+}
+
+int test_hang(void)
+{
+        printf("Waiting forever\n");
+        for (;;)
+        {
+                pause();
+        }
+
+        return 0;
+}
+
+int test_hang_blocked(void)
+{
+        sigset_t all;
+
+        sigfillset(&all);
+        sigprocmask(SIG_BLOCK, &all, NULL);
+        for (;;)
+        {
+                pause();
+        }
+
+        return 0;
+}
+
+int test_flood(void)
+{
+        char line[80];
+
+        memset(line, 'x', sizeof(line) - 1);
+        line[sizeof(line) - 1] = 0;
+        for (int i = 0; i < 16 * 1024; ++i)
+        {
+                printf("%s\n", line);
+        }
+
+        return 0;
+}
+
+int bench_sum(struct scut_bench* bench)
+{
+        static unsigned char data[4096];
+
+        SCUT_BENCH_BYTES(sizeof(data));
+        SCUT_BENCH_LOOP
+        {
+                unsigned long sum = 0;
+
+                for (size_t i = 0; i < sizeof(data); ++i)
+                {
+                        sum += data[i];
+                }
+                SCUT_DO_NOT_OPTIMIZE(sum);
+        }
+
+        return 0;
+}
+
+int test_add(const void* p)
+{
+        const struct add_case* c = p;
+
+        SCUT_ASSERT_IE(c->a + c->b, c->sum);
+
+        return 0;
+}
+
+int prop_sum(struct scut_prop* p)
+{
+        long long a = scut_gen_int(p, -100000, 100000);
+        long long b = scut_gen_int(p, -100000, 100000);
+
+        printf("a=%lld b=%lld\n", a, b);
+        SCUT_ASSERT_TRUE(a + b < 1000);
+
+        return 0;
+}
+
+int prop_string(struct scut_prop* p)
+{
+        char s[16];
+        unsigned char b[16];
+        size_t n = scut_gen_string(p, s, sizeof(s));
+        double d = scut_gen_double(p, -1.0, 1.0);
+
+        SCUT_ASSERT_IE(strlen(s), n);
+        SCUT_ASSERT_TRUE(d >= -1.0 && d < 1.0);
+        SCUT_ASSERT_TRUE(scut_gen_bytes(p, b, sizeof(b)) <= sizeof(b));
+
+        return 0;
+}
+
+int prop_hang(struct scut_prop* p)
+{
+        (void)p;
+        for (;;)
+        {
+                pause();
+        }
+
+        return 0;
+}
+
+int test_fixture_pid(void)
+{
+        pid_t* pid = scut_fixture(&pid_fixture);
+
+        SCUT_ASSERT_TRUE(pid == &fixture_pid);
+        SCUT_ASSERT_IE(*pid, main_pid);
+        SCUT_ASSERT_IE(setups, 1);
+
+        return 0;
+}
+
+int test_fixture_broken(void)
+{
+        return 0;
+}
+
+int bench_fail(struct scut_bench* bench)
+{
+        SCUT_ASSERT_IE(bench->n, 0);
+
+        return 0;
+}